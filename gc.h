@@ -1,6 +1,10 @@
 #ifndef GC_H
 #define GC_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                                        // pthread_getattr_np
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -9,42 +13,572 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+
+#ifndef __USE_GNU
+extern int pthread_getattr_np(pthread_t thread, pthread_attr_t* attr);
+#endif
 
 #define GC_HEAP_SIZE (1024 * 1024) 
 #define GC_THRESHOLD 0.8          
 #define GC_MAX_OBJECTS 10000        
 #define GC_ALIGNMENT 8          
 
-#define GC_DEBUG 1
+// The heap is a set of separately mmap'd regions. GC_HEAP_SIZE is both the
+// default region size and the smallest heap the growth policy aims for.
+#define GC_REGION_SIZE GC_HEAP_SIZE
+#define GC_GROWTH_FACTOR 2.0
+
+// Collection pacing. A full collection runs once heap_used reaches the
+// trigger: the live bytes left by the previous one times growth_factor, so
+// 2.0 collects whenever the heap has doubled (GOGC=100). The trigger never
+// drops below GC_THRESHOLD of min_heap_size nor exceeds max_heap_size.
+// While collector time exceeds cpu_target of the wall clock between full
+// collections, the trigger is pushed out, up to GC_PACE_MAX times, and it
+// is drawn back in once the share falls under half the target.
+#ifndef GC_CPU_TARGET
+#define GC_CPU_TARGET 0.25
+#endif
+#ifndef GC_PACE_MAX
+#define GC_PACE_MAX 2.0
+#endif
+
+// Size-segregated free lists: blocks up to GC_SIZE_CLASS_MAX bytes (header
+// included) are kept in per-class buckets, larger ones in power-of-two bins
+// (bin i holds sizes in [2^(i+9), 2^(i+10)), the last one everything above).
+// A bin is searched first-fit for at most GC_LARGE_BIN_SCAN blocks before
+// the next non-empty bin, where any block fits, is split instead.
+#define GC_SIZE_CLASS_STEP 16
+#define GC_SIZE_CLASS_MAX 512
+#define GC_NUM_SIZE_CLASSES (GC_SIZE_CLASS_MAX / GC_SIZE_CLASS_STEP)
+#define GC_LARGE_BIN_SHIFT 9                               // log2(GC_SIZE_CLASS_MAX)
+#define GC_NUM_LARGE_BINS 48
+#ifndef GC_LARGE_BIN_SCAN
+#define GC_LARGE_BIN_SCAN 8
+#endif
+
+// Object-start bitmap: one bit per GC_ALIGNMENT granule of a region, set at
+// the header address of every allocated object.
+#define GC_BITMAP_WORD_BITS 64
+#define GC_BITMAP_WORDS(region_size) \
+    (((region_size) / GC_ALIGNMENT + GC_BITMAP_WORD_BITS - 1) / GC_BITMAP_WORD_BITS)
+
+// gc_realloc grows in place when the block after the object is free. When
+// it has to move, the new block is at least GC_REALLOC_GROWTH times the old
+// one, so a buffer grown one step at a time is copied O(log n) times.
+#ifndef GC_REALLOC_GROWTH
+#define GC_REALLOC_GROWTH 1.5
+#endif
+
+// Explicit mark stack (entries, not bytes). It is mmap'd outside the heap
+// and doubles on demand up to GC_MARK_STACK_MAX; past that, marking falls
+// back to rescanning the heap for marked objects with unmarked children.
+#ifndef GC_MARK_STACK_INITIAL
+#define GC_MARK_STACK_INITIAL 4096
+#endif
+#ifndef GC_MARK_STACK_MAX
+#define GC_MARK_STACK_MAX (1024 * 1024)
+#endif
+
+// Threads allocate small objects by bumping through a private buffer carved
+// from the free lists, so the common path takes no lock. Collections stop
+// every registered thread with GC_SUSPEND_SIGNAL and restart them with
+// GC_RESUME_SIGNAL; pick others if the application already uses these.
+#ifndef GC_TLAB_SIZE
+#define GC_TLAB_SIZE (16 * 1024)
+#endif
+#ifndef GC_SUSPEND_SIGNAL
+#define GC_SUSPEND_SIGNAL SIGPWR
+#endif
+#ifndef GC_RESUME_SIGNAL
+#define GC_RESUME_SIGNAL SIGXCPU
+#endif
+
+// Parallel marking. GC_MARK_THREADS is the default marker count (1 keeps
+// marking on the collecting thread); gc_configure changes it at runtime.
+// Each marker owns a fixed work-stealing deque of GC_MARK_DEQUE_SIZE
+// entries (a power of two); when it fills up, marking falls back to the
+// same overflow rescan as the serial mark stack.
+#ifndef GC_MARK_THREADS
+#define GC_MARK_THREADS 1
+#endif
+#ifndef GC_MARK_THREADS_MAX
+#define GC_MARK_THREADS_MAX 64
+#endif
+#ifndef GC_MARK_DEQUE_SIZE
+#define GC_MARK_DEQUE_SIZE (64 * 1024)
+#endif
+#ifndef GC_PARALLEL_MARK_MIN
+#define GC_PARALLEL_MARK_MIN 64                            // Grey objects worth waking markers for
+#endif
+
+// Lazy sweeping. When enabled (GC_LAZY_SWEEP or gc_configure), a collection
+// only marks; the heap is then swept in slices of GC_SWEEP_SLICE bytes by
+// allocations that miss the free lists, or by gc_sweep_step.
+#ifndef GC_LAZY_SWEEP
+#define GC_LAZY_SWEEP 0
+#endif
+#ifndef GC_SWEEP_SLICE
+#define GC_SWEEP_SLICE (256 * 1024)
+#endif
+
+// Incremental marking. gc_step starts a cycle once heap_used reaches
+// GC_INCREMENTAL_START of the collection trigger and then marks in
+// time-bounded increments. Pointer stores made through GC_WRITE while a
+// cycle runs are remembered in a per-thread buffer of GC_BARRIER_BUFFER
+// entries.
+#ifndef GC_INCREMENTAL_START
+#define GC_INCREMENTAL_START 0.5
+#endif
+#ifndef GC_BARRIER_BUFFER
+#define GC_BARRIER_BUFFER 1024
+#endif
+
+// Generational mode (GC_GENERATIONAL or gc_configure). Objects allocated
+// since the last collection are young; a minor collection runs once
+// nursery_size bytes have been handed out, traces only young objects and
+// promotes the survivors in place (mark bits stay set while an object is
+// old). Old-to-young pointers must be stored through GC_WRITE.
+#ifndef GC_GENERATIONAL
+#define GC_GENERATIONAL 0
+#endif
+#ifndef GC_NURSERY_SIZE
+#define GC_NURSERY_SIZE (2 * 1024 * 1024)
+#endif
+
+// Mostly-copying compaction (GC_COMPACT or gc_configure). When the last
+// sweep left at least GC_COMPACT_FRAGMENTATION of the free bytes in holes
+// smaller than GC_COMPACT_HOLE, the next full collection evacuates the survivors
+// of regions less than GC_COMPACT_LIVE_RATIO live into fresh regions.
+// Only precise references move their target: pointer fields of typed
+// objects (gc_malloc_typed), gc_add_root slots and root scanner slots, which
+// are rewritten. Anything a stack, register, conservative root range or
+// conservative object word points at is pinned and stays put, and those
+// words are never rewritten.
+#ifndef GC_COMPACT
+#define GC_COMPACT 0
+#endif
+#ifndef GC_COMPACT_FRAGMENTATION
+#define GC_COMPACT_FRAGMENTATION 0.5
+#endif
+#ifndef GC_COMPACT_LIVE_RATIO
+#define GC_COMPACT_LIVE_RATIO 0.5
+#endif
+#ifndef GC_COMPACT_HOLE
+#define GC_COMPACT_HOLE 4096
+#endif
+
+// Finalizers and weak references are examined in one batch once marking is
+// done. Finalizers of dead objects are queued and run after the world has
+// restarted: by the next allocation slow path or gc_force_collect to see
+// them, or only by gc_run_finalizers with GC_FINALIZE_ON_DEMAND (or
+// finalize_on_demand in gc_config_t).
+#ifndef GC_FINALIZE_ON_DEMAND
+#define GC_FINALIZE_ON_DEMAND 0
+#endif
+
+// Roots. Thread stacks and registers are scanned conservatively unless
+// GC_SCAN_STACKS (or scan_stacks in gc_config_t) is 0; globals are only
+// seen through gc_add_root, gc_add_root_range or a root scanner.
+#ifndef GC_SCAN_STACKS
+#define GC_SCAN_STACKS 1
+#endif
+
+// Logging is tiered. GC_LOG_LEVEL is the most verbose level compiled in;
+// anything above it costs nothing. Compiled-in levels are further filtered
+// at runtime by gc_set_log_level. DEBUG and TRACE sit on the allocation and
+// marking hot paths, so they are compiled out unless asked for.
+#define GC_LOG_LEVEL_NONE  0
+#define GC_LOG_LEVEL_ERROR 1
+#define GC_LOG_LEVEL_WARN  2
+#define GC_LOG_LEVEL_INFO  3                               // Collections, heap resizing
+#define GC_LOG_LEVEL_DEBUG 4                               // Phase details
+#define GC_LOG_LEVEL_TRACE 5                               // Per allocation / per pointer
+
+#ifndef GC_DEBUG
+#define GC_DEBUG 0
+#endif
+
+#ifndef GC_LOG_LEVEL
+#if GC_DEBUG
+#define GC_LOG_LEVEL GC_LOG_LEVEL_TRACE
+#else
+#define GC_LOG_LEVEL GC_LOG_LEVEL_INFO
+#endif
+#endif
 
+#ifndef GC_LOG_LEVEL_DEFAULT
 #if GC_DEBUG
-#define GC_LOG(fmt, ...) printf("[GC] " fmt "\n", ##__VA_ARGS__)
+#define GC_LOG_LEVEL_DEFAULT GC_LOG_LEVEL_TRACE
+#else
+#define GC_LOG_LEVEL_DEFAULT GC_LOG_LEVEL_WARN
+#endif
+#endif
+
+static int gc_log_level = GC_LOG_LEVEL_DEFAULT;
+static FILE* gc_log_stream = NULL;                         // NULL means stderr
+
+static void gc_log_write(int level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define GC_LOG_AT(level, fmt, ...) \
+    do { \
+        if (GC_LOG_LEVEL >= (level) && gc_log_level >= (level)) \
+            gc_log_write((level), fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define GC_LOG_ERROR(fmt, ...) GC_LOG_AT(GC_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define GC_LOG_WARN(fmt, ...)  GC_LOG_AT(GC_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define GC_LOG_INFO(fmt, ...)  GC_LOG_AT(GC_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define GC_LOG_DEBUG(fmt, ...) GC_LOG_AT(GC_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define GC_LOG_TRACE(fmt, ...) GC_LOG_AT(GC_LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#define GC_LOG(fmt, ...)       GC_LOG_DEBUG(fmt, ##__VA_ARGS__)
+
+// Trace events go to an in-memory ring buffer instead of a stream, so they
+// can stay on in production and be dumped when something looks wrong.
+// GC_TRACE_RING_SIZE is the number of events kept; 0 compiles tracing out.
+// Any thread may record: each event claims its slot with one atomic add, so
+// lock-free TLAB allocations are traced like everything else.
+#ifndef GC_TRACE_RING_SIZE
+#define GC_TRACE_RING_SIZE 0
+#endif
+
+typedef enum {
+    GC_EVENT_ALLOC,                                        // a = object, b = bytes
+    GC_EVENT_COLLECT_BEGIN,                                // a = collection, b = heap used
+    GC_EVENT_MARK_END,                                     // a = objects marked
+    GC_EVENT_SWEEP_END,                                    // a = objects swept, b = bytes freed
+    GC_EVENT_COLLECT_END,                                  // a = heap used, b = heap size
+    GC_EVENT_REGION_MAP,                                   // a = region, b = bytes
+    GC_EVENT_REGION_UNMAP,                                 // a = region, b = bytes
+    GC_EVENT_MARK_STEP,                                    // a = objects scanned, b = grey left
+    GC_EVENT_COUNT
+} gc_event_type_t;
+
+typedef struct gc_trace_event {
+    uint64_t seq;                                          // Index + 1 once fully written
+    uint64_t time_ns;
+    uint32_t type;
+    uintptr_t a;
+    uintptr_t b;
+} gc_trace_event_t;
+
+#if GC_TRACE_RING_SIZE > 0
+static struct {
+    gc_trace_event_t events[GC_TRACE_RING_SIZE];
+    uint64_t next;                                         // Total events recorded
+    uint64_t flushed;                                      // Events already written out
+    int enabled;
+} gc_trace_ring = { .enabled = 1 };
+
+static void gc_trace_record(gc_event_type_t type, uintptr_t a, uintptr_t b);
+
+#define GC_TRACE(type, a, b) \
+    do { \
+        if (gc_trace_ring.enabled) \
+            gc_trace_record((type), (uintptr_t)(a), (uintptr_t)(b)); \
+    } while (0)
 #else
-#define GC_LOG(fmt, ...) ((void)0)
+#define GC_TRACE(type, a, b) ((void)0)
 #endif
 
 typedef struct gc_object {
     size_t size;
     int marked;
-    struct gc_object* next;
-    char data[];
+    unsigned short flags;                                  // GC_FLAG_*
+    unsigned short kind;                                   // How the marker scans it, GC_KIND_*
+    char data[] __attribute__((aligned(GC_ALIGNMENT)));
 } gc_object_t;
 
+// Object kinds. Conservative objects have every word scanned, atomic ones
+// hold no pointers and are never scanned, and typed ones only have the words
+// their registered layout lists scanned: kind - GC_KIND_TYPED is the layout.
+#define GC_KIND_CONSERVATIVE 0
+#define GC_KIND_ATOMIC       1
+#define GC_KIND_TYPED        2
+#define GC_LAYOUT_MAX        (65535 - GC_KIND_TYPED)
+
+#define GC_FLAG_PINNED    0x1                              // Referenced ambiguously
+#define GC_FLAG_FORWARDED 0x2                              // Evacuated; data starts with the copy
+#define GC_FLAG_FINALIZER 0x4                              // Has an entry in gc_state.finalizers
+
+// Called with an object that became unreachable, and the data it was
+// registered with
+typedef void (*gc_finalizer_fn)(void* obj, void* data);
+
+typedef struct {
+    void* obj;
+    gc_finalizer_fn fn;
+    void* data;
+} gc_finalizer_t;
+
+// Weak reference made by gc_weak_new. It is an atomic GC object, so the
+// marker never sees the target through it; read it with gc_weak_get.
+typedef struct gc_weak {
+    void* target;
+} gc_weak_t;
+
+// Root scanners report the slots they know hold GC pointers through the
+// visitor. They run with the world stopped and must not allocate.
+typedef void (*gc_root_visitor_fn)(void** slot);
+typedef void (*gc_root_scanner_fn)(gc_root_visitor_fn visit, void* data);
+
+typedef struct {
+    char* start;
+    char* end;
+    int precise;                                           // A single slot from gc_add_root
+} gc_root_range_t;
+
+// Free blocks are doubly linked so one found by address unlinks in O(1)
 typedef struct gc_free_block {
     size_t size;
     struct gc_free_block* next;
+    struct gc_free_block* prev;
 } gc_free_block_t;
 
+// One mmap'd chunk of the heap. Objects never span regions, and every byte
+// of a region is either an object (start bit set), a listed free block
+// (free bit set) or a gap too small to reuse. The descriptor shares a
+// mapping with its bitmaps, so its address is stable for the region's
+// lifetime.
+typedef struct gc_region {
+    char* start;
+    size_t size;
+    size_t live_bytes;                                     // As of the last sweep
+    uint64_t* start_bitmap;
+    uint64_t* free_bitmap;                                 // Header of every listed free block
+    size_t bitmap_words;
+    size_t meta_size;                                      // Descriptor + bitmaps mapping
+    int needs_sweep;                                       // Marked but not yet swept
+    size_t sweep_word;                                     // Next bitmap word to sweep
+    char* sweep_cursor;                                    // End of the last live object
+    int evacuating;                                        // Being emptied by compaction
+} gc_region_t;
+
+// Per-thread state, allocated outside the heap and linked into
+// gc_state.threads while the thread is registered. Everything but the TLAB
+// cursor is only touched under gc_state.lock or while the world is stopped.
+typedef struct gc_thread {
+    pthread_t id;
+    char* stack_hi;                                        // Stack base (highest address)
+    void* stack_top;                                       // SP saved when suspended
+    jmp_buf registers;                                     // Registers saved when suspended
+    int suspended;
+    char* tlab_cur;                                        // Thread-local allocation buffer
+    char* tlab_end;
+    gc_region_t* tlab_region;
+    int allocation_count;                                  // Not yet folded into gc_state
+    int object_count;
+    size_t allocated_bytes;
+    int class_live_count[GC_NUM_SIZE_CLASSES];
+    volatile sig_atomic_t in_alloc;                        // Inside the lock-free fast path
+    volatile sig_atomic_t suspend_pending;                 // Suspend deferred until it leaves
+    int black_count;                                       // Allocated during marking
+    size_t black_bytes;
+    int tlab_young;                                        // Young range of the TLAB, or -1
+    void* finalizing;                                      // Object whose finalizer is running
+    int barrier_count;                                     // Write barrier buffer
+    void** barrier_buf[GC_BARRIER_BUFFER];                 // Slots stored to
+    struct gc_thread* next;
+} gc_thread_t;
+
+static __thread gc_thread_t* gc_self = NULL;
+static __thread int gc_finalizing = 0;                     // Inside gc_run_finalizers
+
+// Heap growth policy. After each collection the heap is grown (or shrunk,
+// by releasing empty regions) towards live bytes * growth_factor.
+// Collector work is timed per phase. Pause histograms use power-of-two
+// buckets: bucket 0 counts pauses under 1 us, bucket i those of
+// [2^(i-1), 2^i) us, and the last one everything longer.
+#define GC_PHASE_MARK     0                                // Roots, tracing, incremental steps
+#define GC_PHASE_SWEEP    1                                // Eager sweeps and lazy slices
+#define GC_PHASE_COALESCE 2                                // Folding size classes back together
+#define GC_PHASE_COMPACT  3                                // Evacuation and fix-up
+#define GC_PHASE_COUNT    4
+#define GC_PAUSE_BUCKETS  24
+
+// Snapshot filled by gc_get_stats. Every counter is kept up to date as the
+// collector runs, so taking one never walks the heap.
+typedef struct gc_stats {
+    size_t heap_size;                                      // Mapped heap bytes
+    size_t live_bytes;                                     // Marked at the last collection plus allocated since
+    size_t live_objects;
+    size_t free_bytes;
+    size_t largest_free_block;                             // As of the last complete sweep
+    double fragmentation;                                  // Likewise
+    uint64_t collections;                                  // Full collections
+    uint64_t minor_collections;
+    uint64_t compactions;
+    uint64_t allocations;
+    uint64_t allocated_bytes;                              // Since start-up
+    double allocation_rate;                                // Bytes per second since the last collection
+    size_t next_trigger;                                   // heap_used that starts the next full collection
+    double gc_cpu_share;                                   // Collector share of the last pacing interval
+    uint64_t finalizers_run;
+    uint64_t weak_cleared;                                 // Weak references whose target died
+    uint64_t sweep_slices;                                 // Lazy sweep slices run
+    uint64_t sweep_slice_bytes;                            // Heap bytes they covered
+    uint64_t sweep_slice_freed;                            // Bytes they freed
+    int sweep_pending;                                     // Regions still to sweep lazily
+    uint64_t pause_count[GC_PHASE_COUNT];                  // Indexed by GC_PHASE_*
+    uint64_t pause_total_ns[GC_PHASE_COUNT];
+    uint64_t pause_max_ns[GC_PHASE_COUNT];
+    uint64_t pause_histogram[GC_PHASE_COUNT][GC_PAUSE_BUCKETS];
+} gc_stats_t;
+
+typedef struct gc_config {
+    size_t region_size;                                    // Growth granularity
+    size_t min_heap_size;                                  // Floor for the heap target
+    size_t max_heap_size;                                  // 0 for no limit
+    double growth_factor;
+    int mark_threads;                                      // Markers per collection, 1 = serial
+    int lazy_sweep;                                        // Sweep on demand after marking
+    int generational;                                      // Minor collections of young objects
+    size_t nursery_size;                                   // Young bytes between minor collections
+    int compact;                                           // Evacuate sparse regions when fragmented
+    double cpu_target;                                     // Collector time share to pace for, 0 = off
+    int finalize_on_demand;                                // Finalizers only run from gc_run_finalizers
+    int scan_stacks;                                       // Conservatively scan stacks and registers
+} gc_config_t;
+
+// Pointer map of a typed object: bit i set if word i may hold a pointer.
+// Objects longer than the layout repeat it (arrays of the struct).
+typedef struct gc_layout {
+    size_t words;
+    uint64_t* bits;
+} gc_layout_t;
+
+// Memory handed out since the last collection: a TLAB chunk or one object
+typedef struct gc_young_range {
+    char* start;
+    char* end;
+} gc_young_range_t;
+
+// One parallel marker. The owner pushes and pops at bottom, thieves take
+// from top (Chase-Lev); both indices only ever grow.
+typedef struct gc_marker {
+    gc_object_t** deque;
+    volatile long top;
+    volatile long bottom;
+    int index;
+    int marked_count;
+    size_t marked_bytes;
+    pthread_t thread;                                      // Unused for marker 0
+    unsigned rng;                                          // Victim selection
+} gc_marker_t;
+
+static __thread gc_marker_t* gc_marker = NULL;             // Set while marking in parallel
+
 static struct {
-    char* heap;
+    gc_region_t** regions;                                 // Sorted by start address
+    int region_count;
+    int region_capacity;
+    gc_region_t* last_region;                              // Lookup cache
+    char* heap_lo;                                         // Bounds of all regions
+    char* heap_hi;
     size_t heap_size;
     size_t heap_used;
-    gc_object_t* objects;
-    gc_free_block_t* free_list;
+    size_t heap_target;
+    size_t next_trigger;                                   // Collect once heap_used passes it
+    double pace;                                           // Trigger multiplier, 1 to GC_PACE_MAX
+    double gc_cpu_share;                                   // Measured over the last pacing interval
+    uint64_t pace_start_ns;                                // End of the last full collection
+    uint64_t pace_start_gc_ns;                             // Collector time at that point
+    size_t page_size;
+    gc_config_t config;
+    int object_count;
+    int marked_count;
+    size_t marked_bytes;                                   // Live bytes found by the last mark
+    size_t max_object_size;                                // Largest block ever allocated
+    gc_object_t** mark_stack;
+    size_t mark_stack_size;                                // Entries in use
+    size_t mark_stack_capacity;
+    int mark_overflow;                                     // Entries were dropped
+    gc_free_block_t* large_bins[GC_NUM_LARGE_BINS];        // Large blocks by power of two
+    uint64_t large_bin_mask;                               // Bit i set while bin i is non-empty
+    gc_free_block_t* size_classes[GC_NUM_SIZE_CLASSES];    // Small blocks, LIFO per class
+    uint64_t size_class_mask;                              // Bit i set while class i is non-empty
+    int class_free_count[GC_NUM_SIZE_CLASSES];
+    int class_live_count[GC_NUM_SIZE_CLASSES];
     void* stack_bottom;
     void* stack_top;
     int initialized;
     jmp_buf registers;
+    pthread_mutex_t lock;                                  // Guards everything above
+    gc_thread_t* threads;                                  // Registered threads
+    int thread_count;
+    pthread_key_t thread_key;                              // Unregisters on thread exit
+    sem_t suspend_ack;
+    volatile int world_stopped;
+    gc_marker_t* markers[GC_MARK_THREADS_MAX];             // markers[0] is the collector
+    int marker_count;                                      // Helper threads started + 1
+    int active_markers;                                    // Taking part in this cycle
+    pthread_mutex_t mark_lock;                             // Helper wake-up
+    pthread_cond_t mark_cond;
+    unsigned mark_epoch;
+    volatile int markers_idle;                             // Termination protocol
+    volatile int markers_finished;
+    volatile int marking;                                  // Incremental cycle in progress
+    int barrier_overflow;                                  // Barrier stores were lost
+    void*** remset;                                        // Flushed barrier slots
+    size_t remset_count;
+    size_t remset_capacity;
+    volatile int generational;                             // Mirrors config, flipped with the world stopped
+    gc_young_range_t* young;                               // Young memory, in allocation order
+    size_t young_count;
+    size_t young_capacity;
+    int young_overflow;                                    // A range could not be recorded
+    size_t young_bytes;                                    // Handed out since the last collection
+    int minor_count;                                       // Generational statistics
+    size_t promoted_bytes;
+    size_t minor_freed_bytes;
+    uint64_t minor_ns;
+    uint64_t minor_max_ns;
+    int pinning;                                           // Marking pins ambiguous targets
+    double fragmentation;                                  // As of the last complete sweep
+    size_t largest_free;
+    int compactions;                                       // Compaction statistics
+    size_t evacuated_objects;
+    size_t evacuated_bytes;
+    size_t pinned_objects;
+    gc_layout_t* layouts;                                  // Registered by gc_register_layout
+    size_t layout_count;
+    size_t layout_capacity;
+    gc_finalizer_t* finalizers;                            // Registered, object not yet found dead
+    size_t finalizer_count;
+    size_t finalizer_capacity;
+    gc_finalizer_t* finalize_queue;                        // Object dead, finalizer still to run
+    size_t finalize_queue_count;
+    size_t finalize_queue_capacity;
+    gc_weak_t** weak_refs;                                 // Every weak reference not yet collected
+    size_t weak_count;
+    size_t weak_capacity;
+    gc_root_range_t* roots;                                // Registered by gc_add_root*
+    size_t root_count;
+    size_t root_capacity;
+    gc_root_scanner_fn root_scanner;
+    void* root_scanner_data;
+    uint64_t finalizers_run;
+    uint64_t weak_cleared;
+    size_t mark_steps;                                     // Incremental marking statistics
+    uint64_t mark_step_ns;
+    uint64_t mark_step_max_ns;
+    int sweep_pending;                                     // Regions still to sweep lazily
+    size_t sweep_slices;                                   // Lazy sweep statistics
+    size_t sweep_slice_bytes;                              // Heap bytes covered by slices
+    size_t sweep_slice_freed;
+    size_t sweep_last_slice_bytes;
+    uint64_t pause_count[GC_PHASE_COUNT];                  // Phase timings, see gc_stats_t
+    uint64_t pause_total_ns[GC_PHASE_COUNT];
+    uint64_t pause_max_ns[GC_PHASE_COUNT];
+    uint64_t pause_histogram[GC_PHASE_COUNT][GC_PAUSE_BUCKETS];
+    uint64_t allocated_bytes;
+    uint64_t epoch_start_ns;                               // End of the last collection
+    uint64_t epoch_start_bytes;                            // allocated_bytes at that point
     int collection_count;
     int allocation_count;
 } gc_state = {0};
@@ -54,21 +588,84 @@ static void gc_init(void);
 static void gc_collect(void);
 static void gc_mark_roots(void);
 static void gc_mark_object(void* ptr);
+static int gc_deque_push(gc_marker_t* m, gc_object_t* obj);
+static void gc_mark_drain(void);
 static void gc_sweep(void);
+static void gc_sweep_finish(void);
+static int gc_sweep_slice(void);
+static void gc_resize_heap(void);
+static int gc_release_empty_regions(void);
+static void gc_measure_fragmentation(void);
+static void gc_collect_minor(void);
+static uint64_t gc_now_ns(void);
+static void gc_record_phase(int phase, uint64_t start_ns);
 static int gc_is_pointer(void* ptr);
 static void gc_cleanup(void);
-static void* gc_alloc_from_freelist(size_t size);
-static void gc_add_to_freelist(void* ptr, size_t size);
-static void gc_coalesce_freelist(void);
+static void* gc_alloc_from_freelist(size_t size, size_t* block_size);
+static void gc_coalesce_free_blocks(void);
 static gc_object_t* gc_find_object_containing(void* ptr);
+static gc_region_t* gc_region_of(void* ptr);
+static gc_region_t* gc_add_region(size_t size);
+static void gc_release_block(void* ptr, size_t size);
+void gc_register_thread(void);
+int gc_run_finalizers(void);
+static void gc_thread_exit(void* record);
+static void gc_install_signal_handlers(void);
+
+// Emit one log line. Only reached for levels that are compiled in and
+// enabled, so the hot paths never get here by default.
+static void gc_log_write(int level, const char* fmt, ...) {
+    static const char* const names[] = { "", "ERROR", "WARN", "INFO", "DEBUG", "TRACE" };
+    FILE* out = gc_log_stream ? gc_log_stream : stderr;
+    va_list args;
+
+    fprintf(out, "[GC %s] ", names[level]);
+    va_start(args, fmt);
+    vfprintf(out, fmt, args);
+    va_end(args);
+    fputc('\n', out);
+}
+
+#if GC_TRACE_RING_SIZE > 0
+static void gc_trace_record(gc_event_type_t type, uintptr_t a, uintptr_t b) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t seq = __atomic_fetch_add(&gc_trace_ring.next, 1, __ATOMIC_RELAXED);
+    gc_trace_event_t* ev = &gc_trace_ring.events[seq % GC_TRACE_RING_SIZE];
+    ev->time_ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    ev->type = type;
+    ev->a = a;
+    ev->b = b;
+    __atomic_store_n(&ev->seq, seq + 1, __ATOMIC_RELEASE);
+}
+#endif
 
 // Cleanup function for exit handler
 static void gc_cleanup(void) {
-    GC_LOG("Cleanup called - unmapping heap");
-    if (gc_state.heap != MAP_FAILED) {
-        munmap(gc_state.heap, gc_state.heap_size);
+    GC_LOG_INFO("Cleanup called - unmapping heap");
+    if (gc_state.thread_count > 1) {
+        // Other threads may still be running on GC memory; leave the
+        // mappings to the kernel.
+        GC_LOG_INFO("%d threads still registered, not unmapping", gc_state.thread_count);
+        return;
+    }
+    for (int i = 0; i < gc_state.region_count; i++) {
+        gc_region_t* region = gc_state.regions[i];
+        munmap(region->start, region->size);
+        munmap(region, region->meta_size);
     }
-    GC_LOG("Final stats - Collections: %d, Allocations: %d", 
+    if (gc_state.regions) {
+        munmap(gc_state.regions, gc_state.region_capacity * sizeof(gc_region_t*));
+        gc_state.regions = NULL;
+    }
+    gc_state.region_count = 0;
+    gc_state.last_region = NULL;
+    if (gc_state.mark_stack) {
+        munmap(gc_state.mark_stack, gc_state.mark_stack_capacity * sizeof(gc_object_t*));
+        gc_state.mark_stack = NULL;
+    }
+    GC_LOG_INFO("Final stats - Collections: %d, Allocations: %d", 
            gc_state.collection_count, gc_state.allocation_count);
 }
 
@@ -88,18 +685,17 @@ static void* gc_get_stack_pointer(void) {
     volatile int dummy;
     sp = (void*)&dummy;
 #endif
-    GC_LOG("Stack pointer: %p", sp);
     return sp;
 }
 
 // this functio nwill run automatically before main().
 __attribute__((constructor))
 static void gc_init_constructor(void) {
-    GC_LOG("Constructor called - initializing GC");
+    GC_LOG_INFO("Constructor called - initializing GC");
     // Get the stack bottom at the earliest possible moment.
     volatile int stack_var;
     gc_state.stack_bottom = (void*)&stack_var;
-    GC_LOG("Stack bottom set to: %p", gc_state.stack_bottom);
+    GC_LOG_DEBUG("Stack bottom set to: %p", gc_state.stack_bottom);
 
     // Perform the rest of the initialization.
     gc_init();
@@ -107,47 +703,109 @@ static void gc_init_constructor(void) {
 
 static void gc_init(void) {
     if (gc_state.initialized) {
-        GC_LOG("GC already initialized, skipping");
+        GC_LOG_DEBUG("GC already initialized, skipping");
         return;
     }
 
-    GC_LOG("Initializing GC with heap size: %zu bytes", GC_HEAP_SIZE);
-
-    gc_state.heap = mmap(NULL, GC_HEAP_SIZE, 
-                        PROT_READ | PROT_WRITE, 
-                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-
-    if (gc_state.heap == MAP_FAILED) {
-        fprintf(stderr, "GC: Failed to allocate heap\n");
-        exit(1);
-    }
+    GC_LOG_INFO("Initializing GC with heap size: %d bytes", GC_HEAP_SIZE);
 
-    GC_LOG("Heap allocated at: %p", gc_state.heap);
+    gc_state.page_size = (size_t)sysconf(_SC_PAGESIZE);
+    gc_state.config.region_size = GC_REGION_SIZE;
+    gc_state.config.min_heap_size = GC_HEAP_SIZE;
+    gc_state.config.max_heap_size = 0;
+    gc_state.config.growth_factor = GC_GROWTH_FACTOR;
+    gc_state.config.mark_threads = GC_MARK_THREADS;
+    gc_state.config.lazy_sweep = GC_LAZY_SWEEP;
+    gc_state.config.generational = GC_GENERATIONAL;
+    gc_state.config.nursery_size = GC_NURSERY_SIZE;
+    gc_state.config.compact = GC_COMPACT;
+    gc_state.config.cpu_target = GC_CPU_TARGET;
+    gc_state.config.finalize_on_demand = GC_FINALIZE_ON_DEMAND;
+    gc_state.config.scan_stacks = GC_SCAN_STACKS;
+    gc_state.generational = GC_GENERATIONAL;
 
-    gc_state.heap_size = GC_HEAP_SIZE;
+    gc_state.heap_size = 0;
     gc_state.heap_used = 0;
-    gc_state.objects = NULL;
+    gc_state.heap_target = GC_HEAP_SIZE;
+    gc_state.next_trigger = (size_t)(GC_HEAP_SIZE * GC_THRESHOLD);
+    gc_state.pace = 1.0;
+    gc_state.pace_start_ns = gc_now_ns();
+    gc_state.object_count = 0;
+    gc_state.max_object_size = GC_SIZE_CLASS_MAX;          // TLAB objects never exceed it
     gc_state.collection_count = 0;
     gc_state.allocation_count = 0;
+    gc_state.epoch_start_ns = gc_now_ns();
+    for (int i = 0; i < GC_NUM_LARGE_BINS; i++) {
+        gc_state.large_bins[i] = NULL;
+    }
+    gc_state.large_bin_mask = 0;
+
+    for (int i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+        gc_state.size_classes[i] = NULL;
+        gc_state.class_free_count[i] = 0;
+        gc_state.class_live_count[i] = 0;
+    }
+    gc_state.size_class_mask = 0;
+
+    if (!gc_add_region(GC_HEAP_SIZE)) {
+        fprintf(stderr, "GC: Failed to allocate heap\n");
+        exit(1);
+    }
 
-    gc_state.free_list = (gc_free_block_t*)gc_state.heap;
-    gc_state.free_list->size = GC_HEAP_SIZE;
-    gc_state.free_list->next = NULL;
+    GC_LOG_INFO("Heap allocated at: %p", gc_state.heap_lo);
 
-    GC_LOG("Initial free block: %p, size: %zu", gc_state.free_list, gc_state.free_list->size);
+    // Threading: the lock, stop-the-world handshake and the main thread's
+    // registration.
+    pthread_mutex_init(&gc_state.lock, NULL);
+    pthread_mutex_init(&gc_state.mark_lock, NULL);
+    pthread_cond_init(&gc_state.mark_cond, NULL);
+    sem_init(&gc_state.suspend_ack, 0, 0);
+    pthread_key_create(&gc_state.thread_key, gc_thread_exit);
+    gc_install_signal_handlers();
 
     gc_state.initialized = 1;
+    gc_register_thread();
 
     atexit(gc_cleanup);
-    GC_LOG("GC initialization complete");
+    GC_LOG_INFO("GC initialization complete");
+}
+
+// Find the region holding ptr: a bounds check, the last region hit, then a
+// binary search over the sorted region table.
+static gc_region_t* gc_region_of(void* ptr) {
+    char* p = (char*)ptr;
+    if (p < gc_state.heap_lo || p >= gc_state.heap_hi) {
+        return NULL;
+    }
+
+    // The cache is shared by parallel markers; a stale value only costs a search
+    gc_region_t* region = __atomic_load_n(&gc_state.last_region, __ATOMIC_RELAXED);
+    if (region && p >= region->start && p < region->start + region->size) {
+        return region;
+    }
+
+    int lo = 0;
+    int hi = gc_state.region_count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        region = gc_state.regions[mid];
+        if (p < region->start) {
+            hi = mid - 1;
+        } else if (p >= region->start + region->size) {
+            lo = mid + 1;
+        } else {
+            __atomic_store_n(&gc_state.last_region, region, __ATOMIC_RELAXED);
+            return region;
+        }
+    }
+    return NULL;
 }
 
 // Check if pointer is within our heap
 static int gc_is_pointer(void* ptr) {
-    int result = ptr >= (void*)gc_state.heap && 
-                 ptr < (void*)(gc_state.heap + gc_state.heap_size);
+    int result = gc_region_of(ptr) != NULL;
     if (result) {
-        GC_LOG("Pointer %p is within heap bounds", ptr);
+        GC_LOG_TRACE("Pointer %p is within heap bounds", ptr);
     }
     return result;
 }
@@ -156,384 +814,2338 @@ static int gc_is_pointer(void* ptr) {
 static int gc_is_valid_pointer(uintptr_t value) {
     // Check alignment
     if (value % sizeof(void*) != 0) {
-        GC_LOG("Value 0x%lx failed alignment check", value);
+        GC_LOG_TRACE("Value 0x%lx failed alignment check", value);
         return 0;
     }
     
     // Check if it's in our heap
     int result = gc_is_pointer((void*)value);
     if (result) {
-        GC_LOG("Value 0x%lx is a valid pointer", value);
+        GC_LOG_TRACE("Value 0x%lx is a valid pointer", value);
     }
     return result;
 }
 
-// Find the object that contains a given pointer
+// Object-start bitmap helpers. Granule indices are relative to the region base.
+static inline size_t gc_granule_of(gc_region_t* region, void* ptr) {
+    return (size_t)((char*)ptr - region->start) / GC_ALIGNMENT;
+}
+
+// Atomic because neighbouring TLABs can share a bitmap word. Clearing only
+// happens while the world is stopped.
+static inline void gc_bitmap_set(gc_region_t* region, void* obj) {
+    size_t g = gc_granule_of(region, obj);
+    __atomic_fetch_or(&region->start_bitmap[g / GC_BITMAP_WORD_BITS],
+                      (uint64_t)1 << (g % GC_BITMAP_WORD_BITS), __ATOMIC_RELAXED);
+}
+
+// Find the object that contains a given pointer. Walks the start bitmap
+// backwards from ptr to the nearest header, which is O(1) for anything but
+// huge objects: the walk never goes further back than the largest block.
 static gc_object_t* gc_find_object_containing(void* ptr) {
-    if (!gc_is_pointer(ptr)) {
-        GC_LOG("Pointer %p not in heap, cannot find containing object", ptr);
+    gc_region_t* region = gc_region_of(ptr);
+    if (!region) {
+        GC_LOG_TRACE("Pointer %p not in heap, cannot find containing object", ptr);
         return NULL;
     }
 
-    GC_LOG("Searching for object containing pointer %p", ptr);
-    
-    // Search through all objects to find one that contains this pointer
-    for (gc_object_t* obj = gc_state.objects; obj; obj = obj->next) {
-        void* obj_start = obj->data;
-        void* obj_end = (char*)obj->data + obj->size;
-        
-        if (ptr >= obj_start && ptr < obj_end) {
-            GC_LOG("Found object containing %p: object at %p, size %zu", 
-                   ptr, obj_start, obj->size);
-            return obj;
+    size_t g = gc_granule_of(region, ptr);
+    size_t word = g / GC_BITMAP_WORD_BITS;
+    unsigned bit = g % GC_BITMAP_WORD_BITS;
+
+    // Keep only bits at or below ptr's granule in the first word
+    uint64_t bits = region->start_bitmap[word];
+    if (bit < GC_BITMAP_WORD_BITS - 1) {
+        bits &= ((uint64_t)1 << (bit + 1)) - 1;
+    }
+
+    size_t limit_words = gc_state.max_object_size / (GC_ALIGNMENT * GC_BITMAP_WORD_BITS) + 1;
+    while (!bits) {
+        if (word == 0 || limit_words-- == 0) {
+            GC_LOG_TRACE("No object found containing pointer %p", ptr);
+            return NULL;
         }
+        bits = region->start_bitmap[--word];
     }
-    
-    GC_LOG("No object found containing pointer %p", ptr);
+
+    size_t start = word * GC_BITMAP_WORD_BITS + (GC_BITMAP_WORD_BITS - 1 - __builtin_clzll(bits));
+    gc_object_t* obj = (gc_object_t*)(region->start + start * GC_ALIGNMENT);
+
+    if ((char*)ptr >= obj->data && (char*)ptr < obj->data + obj->size) {
+        GC_LOG_TRACE("Found object containing %p: object at %p, size %zu",
+               ptr, obj->data, obj->size);
+        return obj;
+    }
+
+    GC_LOG_TRACE("No object found containing pointer %p", ptr);
     return NULL;
 }
 
-// Mark an object and recursively mark referenced objects
+// Header of the object whose data starts exactly at ptr, or NULL. O(1): the
+// header sits right before the data, and its start bit confirms it is one.
+static gc_object_t* gc_object_of(void* ptr) {
+    gc_object_t* obj = (gc_object_t*)((char*)ptr - sizeof(gc_object_t));
+    if ((uintptr_t)obj % GC_ALIGNMENT) return NULL;
+    gc_region_t* region = gc_region_of(obj);
+    if (!region) return NULL;
+
+    size_t g = gc_granule_of(region, obj);
+    uint64_t word = __atomic_load_n(&region->start_bitmap[g / GC_BITMAP_WORD_BITS], __ATOMIC_RELAXED);
+    if (!(word & ((uint64_t)1 << (g % GC_BITMAP_WORD_BITS)))) {
+        GC_LOG_TRACE("No object header before %p", ptr);
+        return NULL;
+    }
+    return obj;
+}
+
+// Anonymous mapping for collector metadata, kept outside the heap so it is
+// never scanned or handed out. Returns NULL on failure.
+static void* gc_sys_alloc(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// Double a metadata vector of `*capacity` elements (or create it with
+// `initial`). Returns 0 if the mapping fails; the old vector is kept.
+static int gc_sys_grow(void** data, size_t* capacity, size_t elem_size, size_t initial) {
+    size_t new_capacity = *capacity ? *capacity * 2 : initial;
+    void* grown = gc_sys_alloc(new_capacity * elem_size);
+    if (!grown) {
+        return 0;
+    }
+    if (*data) {
+        memcpy(grown, *data, *capacity * elem_size);
+        munmap(*data, *capacity * elem_size);
+    }
+    *data = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Grow the mark stack to twice its size. Returns 0 if it is already at
+// GC_MARK_STACK_MAX or the mapping fails; the caller then records overflow.
+static int gc_mark_stack_grow(void) {
+    size_t new_capacity = gc_state.mark_stack_capacity ?
+                          gc_state.mark_stack_capacity * 2 : GC_MARK_STACK_INITIAL;
+    if (new_capacity > GC_MARK_STACK_MAX) {
+        return 0;
+    }
+
+    gc_object_t** new_stack = gc_sys_alloc(new_capacity * sizeof(gc_object_t*));
+    if (!new_stack) {
+        GC_LOG_WARN("Failed to grow mark stack to %zu entries", new_capacity);
+        return 0;
+    }
+
+    if (gc_state.mark_stack) {
+        memcpy(new_stack, gc_state.mark_stack, gc_state.mark_stack_size * sizeof(gc_object_t*));
+        munmap(gc_state.mark_stack, gc_state.mark_stack_capacity * sizeof(gc_object_t*));
+    }
+
+    GC_LOG_DEBUG("Mark stack grown to %zu entries", new_capacity);
+    gc_state.mark_stack = new_stack;
+    gc_state.mark_stack_capacity = new_capacity;
+    return 1;
+}
+
+// Push a freshly marked (grey) object. If the stack cannot grow, the object
+// stays marked but unscanned and gc_mark_drain picks it up on a rescan.
+static inline void gc_mark_push(gc_object_t* obj) {
+    if (gc_state.mark_stack_size == gc_state.mark_stack_capacity && !gc_mark_stack_grow()) {
+        gc_state.mark_overflow = 1;
+        return;
+    }
+    gc_state.mark_stack[gc_state.mark_stack_size++] = obj;
+}
+
+// Mark the object containing ptr and queue it for scanning
 static void gc_mark_object(void* ptr) {
     if (!gc_is_pointer(ptr)) {
-        GC_LOG("Pointer %p not in heap, skipping mark", ptr);
+        GC_LOG_TRACE("Pointer %p not in heap, skipping mark", ptr);
         return;
     }
 
-    GC_LOG("Attempting to mark object at %p", ptr);
+    GC_LOG_TRACE("Attempting to mark object at %p", ptr);
 
     // Find the object that contains this pointer
     gc_object_t* obj = gc_find_object_containing(ptr);
     
     if (!obj) {
-        GC_LOG("No object found containing %p, skipping mark", ptr);
+        GC_LOG_TRACE("No object found containing %p, skipping mark", ptr);
+        return;
+    }
+
+    gc_marker_t* marker = gc_marker;
+    if (marker) {
+        // Parallel: whoever sets the bit first owns the object
+        if (obj->marked || __atomic_exchange_n(&obj->marked, 1, __ATOMIC_RELAXED)) {
+            return;
+        }
+        marker->marked_count++;
+        marker->marked_bytes += sizeof(gc_object_t) + obj->size;
+        if (!gc_deque_push(marker, obj)) {
+            __atomic_store_n(&gc_state.mark_overflow, 1, __ATOMIC_RELAXED);
+        }
         return;
     }
 
     if (obj->marked) {
-        GC_LOG("Object at %p already marked, skipping", obj->data);
+        GC_LOG_TRACE("Object at %p already marked, skipping", obj->data);
         return;
     }
 
-    GC_LOG("Marking object at %p, size %zu", obj->data, obj->size);
+    GC_LOG_TRACE("Marking object at %p, size %zu", obj->data, obj->size);
     obj->marked = 1;
-    
-    // Scan object data for pointers
+    gc_state.marked_count++;
+    gc_state.marked_bytes += sizeof(gc_object_t) + obj->size;
+    gc_mark_push(obj);
+}
+
+// Layout of a typed object, or NULL if every word has to be scanned
+static inline const gc_layout_t* gc_layout_of(const gc_object_t* obj) {
+    return obj->kind >= GC_KIND_TYPED ? &gc_state.layouts[obj->kind - GC_KIND_TYPED] : NULL;
+}
+
+// Whether word i of an object with this layout may hold a pointer
+static inline int gc_layout_has_pointer(const gc_layout_t* layout, size_t i) {
+    if (!layout) return 1;
+    size_t w = i % layout->words;
+    return (layout->bits[w / 64] >> (w % 64)) & 1;
+}
+
+// An ambiguous reference (a root word, or a word of a conservative object)
+// may be an integer, so compaction must not move or rewrite what it points
+// to. Atomic because parallel markers may pin the same object.
+static void gc_pin_object(void* ptr) {
+    gc_object_t* obj = gc_find_object_containing(ptr);
+    if (obj) {
+        __atomic_fetch_or(&obj->flags, GC_FLAG_PINNED, __ATOMIC_RELAXED);
+    }
+}
+
+// Scan object data for pointers, marking and queueing what it references.
+// The kind decides which words are looked at. Words of a conservative
+// object are ambiguous, so a compacting mark pins their targets.
+static void gc_scan_object(gc_object_t* obj) {
+    if (obj->kind == GC_KIND_ATOMIC) {
+        return;
+    }
+
     uintptr_t* data = (uintptr_t*)obj->data;
     size_t word_count = obj->size / sizeof(uintptr_t);
+    const gc_layout_t* layout = gc_layout_of(obj);
+    int pin = gc_state.pinning && !layout;
     
-    GC_LOG("Scanning object data for pointers: %zu words", word_count);
+    GC_LOG_TRACE("Scanning object data for pointers: %zu words", word_count);
     
     for (size_t i = 0; i < word_count; i++) {
+        if (layout && !gc_layout_has_pointer(layout, i)) continue;
         if (gc_is_valid_pointer(data[i])) {
-            GC_LOG("Found potential pointer at offset %zu: 0x%lx", i * sizeof(uintptr_t), data[i]);
+            GC_LOG_TRACE("Found potential pointer at offset %zu: 0x%lx", i * sizeof(uintptr_t), data[i]);
+            if (pin) {
+                gc_pin_object((void*)data[i]);
+            }
             gc_mark_object((void*)data[i]);
         }
     }
-    
-    GC_LOG("Finished marking object at %p", obj->data);
 }
 
-// Mark all reachable objects from roots (stack + registers)
-static void gc_mark_roots(void) {
-    GC_LOG("Starting root marking phase");
-    
-    // Save registers to stack
-    setjmp(gc_state.registers);
-    GC_LOG("Registers saved to jmp_buf");
-    
-    // Get current stack pointer
-    gc_state.stack_top = gc_get_stack_pointer();
-    
-    // Determine stack direction and bounds
-    void* stack_start = gc_state.stack_top;
-    void* stack_end = gc_state.stack_bottom;
-    
-    GC_LOG("Stack scan range: %p to %p", stack_start, stack_end);
-    
-    // Ensure we scan in the right direction
-    if (stack_start > stack_end) {
-        void* temp = stack_start;
-        stack_start = stack_end;
-        stack_end = temp;
-        GC_LOG("Stack grows upward, adjusted range: %p to %p", stack_start, stack_end);
+//==============================================================================
+// Parallel marking
+//==============================================================================
+
+#define GC_MARK_DEQUE_MASK (GC_MARK_DEQUE_SIZE - 1)
+
+// Owner only. Returns 0 if the deque is full.
+static int gc_deque_push(gc_marker_t* m, gc_object_t* obj) {
+    long b = __atomic_load_n(&m->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&m->top, __ATOMIC_ACQUIRE);
+    if (b - t >= GC_MARK_DEQUE_SIZE) {
+        return 0;
     }
-    
-    // Scan stack for potential pointers
-    uintptr_t* ptr = (uintptr_t*)stack_start;
-    uintptr_t* end = (uintptr_t*)stack_end;
-    
-    size_t stack_words = (char*)end - (char*)ptr;
-    stack_words /= sizeof(uintptr_t);
-    GC_LOG("Scanning stack: %zu words", stack_words);
-    
-    int stack_pointers_found = 0;
-    while (ptr < end) {
-        if (gc_is_valid_pointer(*ptr)) {
-            GC_LOG("Found stack root at %p: 0x%lx", ptr, *ptr);
-            gc_mark_object((void*)*ptr);
-            stack_pointers_found++;
-        }
-        ptr++;
+    __atomic_store_n(&m->deque[b & GC_MARK_DEQUE_MASK], obj, __ATOMIC_RELAXED);
+    __atomic_store_n(&m->bottom, b + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Owner only. Races with thieves for the last entry.
+static gc_object_t* gc_deque_pop(gc_marker_t* m) {
+    long b = __atomic_load_n(&m->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&m->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&m->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&m->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
     }
-    
-    GC_LOG("Stack scan complete: %d potential pointers found", stack_pointers_found);
-    
-    // Also scan the jmp_buf for registers
-    uintptr_t* reg_ptr = (uintptr_t*)&gc_state.registers;
-    size_t reg_count = sizeof(jmp_buf) / sizeof(uintptr_t);
-    
-    GC_LOG("Scanning registers: %zu words", reg_count);
-    
-    int reg_pointers_found = 0;
-    for (size_t i = 0; i < reg_count; i++) {
-        if (gc_is_valid_pointer(reg_ptr[i])) {
-            GC_LOG("Found register root at index %zu: 0x%lx", i, reg_ptr[i]);
-            gc_mark_object((void*)reg_ptr[i]);
-            reg_pointers_found++;
+
+    gc_object_t* obj = __atomic_load_n(&m->deque[b & GC_MARK_DEQUE_MASK], __ATOMIC_RELAXED);
+    if (t == b) {
+        if (!__atomic_compare_exchange_n(&m->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            obj = NULL;
         }
+        __atomic_store_n(&m->bottom, b + 1, __ATOMIC_RELAXED);
     }
-    
-    GC_LOG("Register scan complete: %d potential pointers found", reg_pointers_found);
-    GC_LOG("Root marking phase complete");
+    return obj;
 }
 
-// Add a block to the free list
-static void gc_add_to_freelist(void* ptr, size_t size) {
-    if (size < sizeof(gc_free_block_t)) {
-        GC_LOG("Block too small for free list: %zu bytes", size);
-        return;
+// Any thread. Returns NULL if empty or if another thief won.
+static gc_object_t* gc_deque_steal(gc_marker_t* m) {
+    long t = __atomic_load_n(&m->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&m->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return NULL;
+    }
+
+    gc_object_t* obj = __atomic_load_n(&m->deque[t & GC_MARK_DEQUE_MASK], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&m->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
     }
+    return obj;
+}
 
-    GC_LOG("Adding block to free list: %p, size %zu", ptr, size);
+static inline int gc_deque_empty(gc_marker_t* m) {
+    return __atomic_load_n(&m->top, __ATOMIC_ACQUIRE) >=
+           __atomic_load_n(&m->bottom, __ATOMIC_ACQUIRE);
+}
 
-    gc_free_block_t* new_block = (gc_free_block_t*)ptr;
-    new_block->size = size;
+// Try every other active marker once, starting at a random victim
+static gc_object_t* gc_marker_steal(gc_marker_t* self) {
+    int n = gc_state.active_markers;
+    self->rng = self->rng * 1103515245u + 12345u;
+    int start = (int)((self->rng >> 16) % (unsigned)n);
 
-    // Insert into free list, keeping it sorted by address.
-    gc_free_block_t** current = &gc_state.free_list;
-    while (*current && (char*)*current < (char*)new_block) {
-        current = &(*current)->next;
+    for (int i = 0; i < n; i++) {
+        gc_marker_t* victim = gc_state.markers[(start + i) % n];
+        if (victim == self) continue;
+        gc_object_t* obj = gc_deque_steal(victim);
+        if (obj) return obj;
     }
-
-    new_block->next = *current;
-    *current = new_block;
-    
-    GC_LOG("Block added to free list successfully");
+    return NULL;
 }
 
-static void gc_coalesce_freelist(void) {
-    if (!gc_state.free_list) {
-        GC_LOG("No free blocks to coalesce");
-        return;
+static int gc_markers_have_work(void) {
+    for (int i = 0; i < gc_state.active_markers; i++) {
+        if (!gc_deque_empty(gc_state.markers[i])) return 1;
     }
-    
-    GC_LOG("Starting free list coalescing");
-    
-    gc_free_block_t* current = gc_state.free_list;
-    int coalesced_count = 0;
-    
-    while (current && current->next) {
-        char* current_end = (char*)current + current->size;
-        char* next_start = (char*)current->next;
-        
-        if (current_end == next_start) {
-            // Adjacent blocks - merge them
-            gc_free_block_t* next = current->next;
-            GC_LOG("Coalescing blocks: %p (size %zu) + %p (size %zu)", 
-                   current, current->size, next, next->size);
-            
-            current->size += next->size;
-            current->next = next->next;
-            coalesced_count++;
-            
-            GC_LOG("Merged block now has size %zu", current->size);
-            // Don't advance current - check for more merges
-        } else {
-            current = current->next;
+    return 0;
+}
+
+// Scan until every deque is empty and every marker is idle. A marker only
+// counts itself idle with an empty deque and nothing in hand, and idle
+// markers push nothing, so once all of them are idle no work is left.
+static void gc_marker_run(gc_marker_t* self) {
+    int n = gc_state.active_markers;
+    gc_marker = self;
+
+    for (;;) {
+        gc_object_t* obj;
+        while ((obj = gc_deque_pop(self)) || (obj = gc_marker_steal(self))) {
+            gc_scan_object(obj);
+        }
+
+        // Marker 0 also owns whatever the serial mark stack still holds
+        if (self->index == 0 && gc_state.mark_stack_size > 0) {
+            while (gc_state.mark_stack_size > 0 &&
+                   gc_deque_push(self, gc_state.mark_stack[gc_state.mark_stack_size - 1])) {
+                gc_state.mark_stack_size--;
+            }
+            continue;
+        }
+
+        __atomic_add_fetch(&gc_state.markers_idle, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n(&gc_state.markers_idle, __ATOMIC_SEQ_CST) == n) {
+                gc_marker = NULL;
+                return;
+            }
+            if (gc_markers_have_work()) {
+                __atomic_sub_fetch(&gc_state.markers_idle, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
         }
     }
-    
-    GC_LOG("Coalescing complete: %d blocks merged", coalesced_count);
 }
 
-// Allocate from free list
-static void* gc_alloc_from_freelist(size_t size) {
-    GC_LOG("Allocating from free list: %zu bytes", size);
-    
-    gc_free_block_t** current = &gc_state.free_list;
-    
-    while (*current) {
-        gc_free_block_t* block = *current;
-        
-        GC_LOG("Checking free block: %p, size %zu", block, block->size);
-        
-        if (block->size >= size) {
-            GC_LOG("Found suitable block: %p, size %zu", block, block->size);
-            
-            // Found a suitable block
-            if (block->size >= size + sizeof(gc_free_block_t) + GC_ALIGNMENT) {
-                // Split the block
-                GC_LOG("Splitting block: using %zu bytes, leaving %zu bytes", 
-                       size, block->size - size);
-                
-                gc_free_block_t* new_block = (gc_free_block_t*)((char*)block + size);
-                new_block->size = block->size - size;
-                new_block->next = block->next;
-                *current = new_block;
-                
-                GC_LOG("Block split successful");
-                return block;
-            } else {
-                // Use entire block
-                GC_LOG("Using entire block");
-                *current = block->next;
-                return block;
-            }
+static void* gc_marker_thread(void* arg) {
+    gc_marker_t* self = (gc_marker_t*)arg;
+    unsigned seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&gc_state.mark_lock);
+        while (gc_state.mark_epoch == seen) {
+            pthread_cond_wait(&gc_state.mark_cond, &gc_state.mark_lock);
+        }
+        seen = gc_state.mark_epoch;
+        int active = self->index < gc_state.active_markers;
+        pthread_mutex_unlock(&gc_state.mark_lock);
+
+        if (active) {
+            gc_marker_run(self);
+            __atomic_add_fetch(&gc_state.markers_finished, 1, __ATOMIC_RELEASE);
         }
-        
-        current = &block->next;
     }
-    
-    GC_LOG("No suitable block found in free list");
-    return NULL; // No suitable block found
+    return NULL;
 }
 
-// Sweep phase - free unmarked objects and rebuild free list
-static void gc_sweep(void) {
-    GC_LOG("Starting sweep phase");
-    
-    gc_object_t** curr = &gc_state.objects;
-    int objects_swept = 0;
-    int objects_kept = 0;
-    size_t bytes_freed = 0;
+static gc_marker_t* gc_marker_new(int index) {
+    gc_marker_t* m = gc_sys_alloc(sizeof(gc_marker_t));
+    if (!m) return NULL;
+    m->deque = gc_sys_alloc(GC_MARK_DEQUE_SIZE * sizeof(gc_object_t*));
+    if (!m->deque) {
+        munmap(m, sizeof(gc_marker_t));
+        return NULL;
+    }
+    m->index = index;
+    m->rng = (unsigned)index * 2654435761u + 1;
+    return m;
+}
+
+// Make sure `wanted` markers exist. Helpers are started once and then park
+// between collections; they never allocate and block every signal, so the
+// world-stopping machinery ignores them. Returns the number available.
+static int gc_markers_start(int wanted) {
+    if (wanted > GC_MARK_THREADS_MAX) wanted = GC_MARK_THREADS_MAX;
+
+    if (gc_state.marker_count == 0) {
+        gc_state.markers[0] = gc_marker_new(0);
+        if (!gc_state.markers[0]) return 1;
+        gc_state.marker_count = 1;
+    }
+
+    if (gc_state.marker_count < wanted) {
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        while (gc_state.marker_count < wanted) {
+            gc_marker_t* m = gc_marker_new(gc_state.marker_count);
+            if (!m) break;
+            if (pthread_create(&m->thread, NULL, gc_marker_thread, m) != 0) {
+                GC_LOG_WARN("Failed to start marker thread %d", gc_state.marker_count);
+                munmap(m->deque, GC_MARK_DEQUE_SIZE * sizeof(gc_object_t*));
+                munmap(m, sizeof(gc_marker_t));
+                break;
+            }
+            pthread_detach(m->thread);
+            gc_state.markers[gc_state.marker_count++] = m;
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        GC_LOG_DEBUG("%d markers available", gc_state.marker_count);
+    }
+    return gc_state.marker_count < wanted ? gc_state.marker_count : wanted;
+}
+
+// Drain the mark stack with every configured marker. Overflowed entries are
+// left to the serial rescan in gc_mark_drain.
+static void gc_mark_parallel(void) {
+    int n = gc_markers_start(gc_state.config.mark_threads);
+    if (n < 2) return;
+
+    // Seed the deques round-robin so helpers have work without stealing
+    for (int i = 0; gc_state.mark_stack_size > 0; i = (i + 1) % n) {
+        if (!gc_deque_push(gc_state.markers[i], gc_state.mark_stack[gc_state.mark_stack_size - 1])) {
+            break;
+        }
+        gc_state.mark_stack_size--;
+    }
+
+    gc_state.active_markers = n;
+    gc_state.markers_idle = 0;
+    gc_state.markers_finished = 0;
+    for (int i = 0; i < n; i++) {
+        gc_state.markers[i]->marked_count = 0;
+        gc_state.markers[i]->marked_bytes = 0;
+    }
+
+    pthread_mutex_lock(&gc_state.mark_lock);
+    gc_state.mark_epoch++;
+    pthread_cond_broadcast(&gc_state.mark_cond);
+    pthread_mutex_unlock(&gc_state.mark_lock);
+
+    gc_marker_run(gc_state.markers[0]);
+
+    // Helpers may still be reading the idle count; wait before reusing it
+    while (__atomic_load_n(&gc_state.markers_finished, __ATOMIC_ACQUIRE) < n - 1) {
+        sched_yield();
+    }
+
+    for (int i = 0; i < n; i++) {
+        gc_state.marked_count += gc_state.markers[i]->marked_count;
+        gc_state.marked_bytes += gc_state.markers[i]->marked_bytes;
+    }
+    GC_LOG_DEBUG("Parallel mark with %d markers complete", n);
+}
+
+// Process the mark stack until every reachable object is scanned. Stack
+// depth is bounded, so a long list costs heap-proportional time instead of
+// one C stack frame per node.
+static void gc_mark_drain(void) {
+    if (gc_state.config.mark_threads > 1 && gc_state.mark_stack_size >= GC_PARALLEL_MARK_MIN) {
+        gc_mark_parallel();
+    }
+
+    for (;;) {
+        while (gc_state.mark_stack_size > 0) {
+            gc_object_t* obj = gc_state.mark_stack[--gc_state.mark_stack_size];
+            gc_scan_object(obj);
+        }
+
+        if (!gc_state.mark_overflow) {
+            break;
+        }
+
+        // Some grey objects were dropped. Rescanning every marked object
+        // re-discovers their unmarked children; repeat until nothing is lost.
+        GC_LOG_DEBUG("Mark stack overflowed, rescanning marked objects");
+        gc_state.mark_overflow = 0;
+        for (int r = 0; r < gc_state.region_count; r++) {
+            gc_region_t* region = gc_state.regions[r];
+            for (size_t w = 0; w < region->bitmap_words; w++) {
+                uint64_t bits = region->start_bitmap[w];
+                while (bits) {
+                    size_t g = w * GC_BITMAP_WORD_BITS + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    gc_object_t* obj = (gc_object_t*)(region->start + g * GC_ALIGNMENT);
+                    if (!obj->marked) continue;
+                    gc_scan_object(obj);
+                    while (gc_state.mark_stack_size > 0) {
+                        gc_scan_object(gc_state.mark_stack[--gc_state.mark_stack_size]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+//==============================================================================
+// Threads
+//==============================================================================
+
+// glibc mangles the stack and frame pointers it stores in a jmp_buf, so a
+// pointer living in rbp would be invisible to the scan. Make the compiler
+// spill every callee-saved register into the current frame instead.
+#if defined(__GNUC__)
+#define GC_SPILL_REGISTERS() __builtin_unwind_init()
+#else
+#define GC_SPILL_REGISTERS() ((void)0)
+#endif
+
+// Park the calling thread until the collector restarts the world. Reached
+// from the suspend handler, or from the allocation fast path when the signal
+// arrived while it was running.
+static void gc_suspend_self(gc_thread_t* self) {
+    sigset_t block, old_mask, wait_mask;
+    sigemptyset(&block);
+    sigaddset(&block, GC_RESUME_SIGNAL);
+    pthread_sigmask(SIG_BLOCK, &block, &old_mask);
+
+    // The registers of the interrupted code are either spilled here or in
+    // the signal frame, which sits above stack_top and is scanned with it.
+    GC_SPILL_REGISTERS();
+    setjmp(self->registers);
+    self->stack_top = gc_get_stack_pointer();
+    sem_post(&gc_state.suspend_ack);
+
+    wait_mask = old_mask;
+    sigdelset(&wait_mask, GC_RESUME_SIGNAL);
+    sigaddset(&wait_mask, GC_SUSPEND_SIGNAL);
+    while (__atomic_load_n(&gc_state.world_stopped, __ATOMIC_ACQUIRE)) {
+        sigsuspend(&wait_mask);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    sem_post(&gc_state.suspend_ack);
+}
+
+static void gc_suspend_handler(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    gc_thread_t* self = gc_self;
+
+    if (self && __atomic_load_n(&gc_state.world_stopped, __ATOMIC_ACQUIRE)) {
+        if (self->in_alloc) {
+            self->suspend_pending = 1;
+        } else {
+            gc_suspend_self(self);
+        }
+    }
+    errno = saved_errno;
+}
+
+static void gc_resume_handler(int sig) {
+    (void)sig;
+}
+
+static void gc_install_signal_handlers(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, GC_RESUME_SIGNAL);
+    sa.sa_handler = gc_suspend_handler;
+    if (sigaction(GC_SUSPEND_SIGNAL, &sa, NULL) != 0) {
+        GC_LOG_ERROR("Failed to install suspend handler");
+    }
+
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = gc_resume_handler;
+    if (sigaction(GC_RESUME_SIGNAL, &sa, NULL) != 0) {
+        GC_LOG_ERROR("Failed to install resume handler");
+    }
+}
+
+// Stop every registered thread except the caller and wait until each has
+// saved its registers and stack pointer. Caller holds gc_state.lock.
+static void gc_stop_world(void) {
+    int signalled = 0;
+    __atomic_store_n(&gc_state.world_stopped, 1, __ATOMIC_RELEASE);
+
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        t->suspended = 0;
+        if (t == gc_self) continue;
+        if (pthread_kill(t->id, GC_SUSPEND_SIGNAL) == 0) {
+            t->suspended = 1;
+            signalled++;
+        } else {
+            GC_LOG_WARN("Registered thread %lu is gone; was it unregistered?",
+                        (unsigned long)t->id);
+        }
+    }
+
+    for (int i = 0; i < signalled; i++) {
+        while (sem_wait(&gc_state.suspend_ack) != 0 && errno == EINTR) {}
+    }
+    GC_LOG_DEBUG("World stopped: %d threads suspended", signalled);
+}
+
+// Restart the threads stopped by gc_stop_world and wait until they have all
+// left the handler, so the next stop cannot race with this one.
+static void gc_start_world(void) {
+    int signalled = 0;
+    __atomic_store_n(&gc_state.world_stopped, 0, __ATOMIC_RELEASE);
+
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        if (!t->suspended) continue;
+        pthread_kill(t->id, GC_RESUME_SIGNAL);
+        signalled++;
+    }
+    for (int i = 0; i < signalled; i++) {
+        while (sem_wait(&gc_state.suspend_ack) != 0 && errno == EINTR) {}
+    }
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        t->suspended = 0;
+    }
+}
+
+// Fold a thread's private counters into the global ones
+static void gc_thread_flush_counters(gc_thread_t* t) {
+    gc_state.allocation_count += t->allocation_count;
+    gc_state.object_count += t->object_count;
+    gc_state.allocated_bytes += t->allocated_bytes;
+    gc_state.marked_count += t->black_count;
+    gc_state.marked_bytes += t->black_bytes;
+    for (int i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+        gc_state.class_live_count[i] += t->class_live_count[i];
+        t->class_live_count[i] = 0;
+    }
+    t->allocation_count = 0;
+    t->object_count = 0;
+    t->allocated_bytes = 0;
+    t->black_count = 0;
+    t->black_bytes = 0;
+}
+
+// Give back the unused tail of a thread's allocation buffer
+static void gc_tlab_retire(gc_thread_t* t) {
+    if (t->tlab_cur && t->tlab_cur < t->tlab_end) {
+        size_t tail = (size_t)(t->tlab_end - t->tlab_cur);
+        gc_release_block(t->tlab_cur, tail);
+        gc_state.heap_used -= tail;
+    }
+    if (t->tlab_young >= 0 && (size_t)t->tlab_young < gc_state.young_count) {
+        gc_state.young[t->tlab_young].end = t->tlab_cur;    // The tail was not used
+    }
+    t->tlab_cur = NULL;
+    t->tlab_end = NULL;
+    t->tlab_region = NULL;
+    t->tlab_young = -1;
+    gc_thread_flush_counters(t);
+}
+
+// Stack bounds of the calling thread. The main thread falls back to the
+// address recorded by the constructor if the query fails.
+static char* gc_thread_stack_base(void) {
+    pthread_attr_t attr;
+    void* addr = NULL;
+    size_t size = 0;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        pthread_attr_getstack(&attr, &addr, &size);
+        pthread_attr_destroy(&attr);
+    }
+    if (addr && size) {
+        return (char*)addr + size;
+    }
+    return (char*)gc_state.stack_bottom;
+}
+
+static void gc_unregister_locked(gc_thread_t* t) {
+    gc_tlab_retire(t);
+    for (gc_thread_t** link = &gc_state.threads; *link; link = &(*link)->next) {
+        if (*link == t) {
+            *link = t->next;
+            gc_state.thread_count--;
+            break;
+        }
+    }
+    munmap(t, sizeof(gc_thread_t));
+}
+
+// pthread key destructor: threads that exit without unregistering
+static void gc_thread_exit(void* record) {
+    gc_thread_t* t = (gc_thread_t*)record;
+    pthread_mutex_lock(&gc_state.lock);
+    gc_unregister_locked(t);
+    pthread_mutex_unlock(&gc_state.lock);
+    gc_self = NULL;
+}
+
+// Make the calling thread known to the collector: its stack and registers
+// become roots and it gets an allocation buffer. gc_malloc does this on a
+// thread's first allocation; threads that only receive GC pointers from
+// others must call it themselves. Safe to call more than once.
+void gc_register_thread(void) {
+    if (gc_self) return;
+    if (!gc_state.initialized) gc_init();
+
+    gc_thread_t* t = gc_sys_alloc(sizeof(gc_thread_t));
+    if (!t) {
+        GC_LOG_ERROR("Failed to allocate thread record");
+        return;
+    }
+    t->id = pthread_self();
+    t->stack_hi = gc_thread_stack_base();
+    t->tlab_young = -1;
+
+    pthread_mutex_lock(&gc_state.lock);
+    t->next = gc_state.threads;
+    gc_state.threads = t;
+    gc_state.thread_count++;
+    gc_self = t;
+    pthread_mutex_unlock(&gc_state.lock);
+
+    pthread_setspecific(gc_state.thread_key, t);
+    GC_LOG_DEBUG("Registered thread %lu, stack base %p", (unsigned long)t->id, t->stack_hi);
+}
+
+// Stop treating the calling thread's stack as a root
+void gc_unregister_thread(void) {
+    gc_thread_t* t = gc_self;
+    if (!t) return;
+
+    pthread_setspecific(gc_state.thread_key, NULL);
+    pthread_mutex_lock(&gc_state.lock);
+    gc_unregister_locked(t);
+    pthread_mutex_unlock(&gc_state.lock);
+    gc_self = NULL;
+}
+
+typedef struct {
+    void* (*start)(void*);
+    void* arg;
+} gc_thread_start_t;
+
+static void* gc_thread_trampoline(void* p) {
+    gc_thread_start_t start = *(gc_thread_start_t*)p;
+    munmap(p, sizeof(gc_thread_start_t));
+
+    gc_register_thread();
+    void* result = start.start(start.arg);
+    gc_unregister_thread();
+    return result;
+}
+
+// pthread_create for threads that use GC memory: registered before
+// start_routine runs and unregistered when it returns.
+int gc_pthread_create(pthread_t* thread, const pthread_attr_t* attr,
+                      void* (*start_routine)(void*), void* arg) {
+    gc_thread_start_t* start = gc_sys_alloc(sizeof(gc_thread_start_t));
+    if (!start) return EAGAIN;
+    start->start = start_routine;
+    start->arg = arg;
+
+    int rc = pthread_create(thread, attr, gc_thread_trampoline, start);
+    if (rc != 0) {
+        munmap(start, sizeof(gc_thread_start_t));
+    }
+    return rc;
+}
+
+//==============================================================================
+// Root marking
+//==============================================================================
+
+// Conservatively mark every word in [start, end)
+static int gc_mark_range(void* start, void* end) {
+    // Ensure we scan in the right direction
+    if (start > end) {
+        void* temp = start;
+        start = end;
+        end = temp;
+    }
+
+    uintptr_t* ptr = (uintptr_t*)(((uintptr_t)start + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1));
+    uintptr_t* stop = (uintptr_t*)end;
+    int found = 0;
+
+    while (ptr < stop) {
+        if (gc_is_valid_pointer(*ptr)) {
+            GC_LOG_TRACE("Found root at %p: 0x%lx", ptr, *ptr);
+            if (gc_state.pinning) {
+                gc_pin_object((void*)*ptr);
+            }
+            gc_mark_object((void*)*ptr);
+            found++;
+        }
+        ptr++;
+    }
+    return found;
+}
+
+// Root visitor used while marking. The slot is known to hold a pointer,
+// so compaction redirects it instead of pinning the target.
+static void gc_visit_root(void** slot) {
+    if (gc_is_valid_pointer((uintptr_t)*slot)) {
+        gc_mark_object(*slot);
+    }
+}
+
+// Stacks and registers of the collecting thread and every suspended one
+static void gc_scan_stacks(void) {
+    // Save registers to stack
+    GC_SPILL_REGISTERS();
+    setjmp(gc_state.registers);
+    GC_LOG_DEBUG("Registers saved to jmp_buf");
     
-    while (*curr) {
-        gc_object_t* obj = *curr;
-        
-        if (!obj->marked) {
-            GC_LOG("Sweeping unmarked object: %p, size %zu", obj->data, obj->size);
-            
-            // Remove from objects list
-            *curr = obj->next;
-            
-            // Add to free list
-            size_t total_size = sizeof(gc_object_t) + obj->size;
-            gc_add_to_freelist(obj, total_size);
-            gc_state.heap_used -= total_size;
-            
-            objects_swept++;
-            bytes_freed += total_size;
+    // Get current stack pointer
+    gc_state.stack_top = gc_get_stack_pointer();
+    void* stack_base = gc_self ? (void*)gc_self->stack_hi : gc_state.stack_bottom;
+    
+    GC_LOG_DEBUG("Stack scan range: %p to %p", gc_state.stack_top, stack_base);
+    int found = gc_mark_range(gc_state.stack_top, stack_base);
+    found += gc_mark_range(&gc_state.registers, (char*)&gc_state.registers + sizeof(jmp_buf));
+    GC_LOG_DEBUG("Own stack and registers: %d potential pointers found", found);
+
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        if (!t->suspended) continue;
+        found = gc_mark_range(t->stack_top, t->stack_hi);
+        found += gc_mark_range(&t->registers, (char*)&t->registers + sizeof(jmp_buf));
+        GC_LOG_DEBUG("Thread %lu: %d potential pointers found", (unsigned long)t->id, found);
+    }
+}
+
+// Grey every object referenced from the roots: stacks and registers unless
+// turned off, registered roots, the root scanner and the finalization queue.
+static void gc_scan_roots(void) {
+    GC_LOG_DEBUG("Starting root marking phase");
+    if (gc_state.config.scan_stacks) {
+        gc_scan_stacks();
+    }
+
+    for (size_t i = 0; i < gc_state.root_count; i++) {
+        gc_root_range_t* root = &gc_state.roots[i];
+        if (root->precise) {
+            gc_visit_root((void**)root->start);
         } else {
-            GC_LOG("Keeping marked object: %p, size %zu", obj->data, obj->size);
-            
-            // Reset mark for next collection
-            obj->marked = 0;
-            curr = &obj->next;
-            objects_kept++;
+            gc_mark_range(root->start, root->end);
+        }
+    }
+    if (gc_state.root_scanner) {
+        gc_state.root_scanner(gc_visit_root, gc_state.root_scanner_data);
+    }
+
+    // Objects waiting for their finalizer stay alive until it has run; the
+    // one being finalized is only known to its thread's frame, so it stays put
+    for (size_t i = 0; i < gc_state.finalize_queue_count; i++) {
+        gc_mark_object(gc_state.finalize_queue[i].obj);
+    }
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        if (!t->finalizing) continue;
+        if (gc_state.pinning) {
+            gc_pin_object(t->finalizing);
+        }
+        gc_mark_object(t->finalizing);
+    }
+}
+
+// Mark all reachable objects from roots
+static void gc_mark_roots(void) {
+    gc_scan_roots();
+    gc_mark_drain();
+    GC_LOG_DEBUG("Root marking phase complete");
+}
+
+//==============================================================================
+// Incremental marking
+//==============================================================================
+
+static uint64_t gc_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Account one stretch of collector work that began at start_ns
+static void gc_record_phase(int phase, uint64_t start_ns) {
+    uint64_t elapsed = gc_now_ns() - start_ns;
+    uint64_t us = elapsed / 1000;
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if (bucket >= GC_PAUSE_BUCKETS) bucket = GC_PAUSE_BUCKETS - 1;
+
+    gc_state.pause_count[phase]++;
+    gc_state.pause_total_ns[phase] += elapsed;
+    if (elapsed > gc_state.pause_max_ns[phase]) gc_state.pause_max_ns[phase] = elapsed;
+    gc_state.pause_histogram[phase][bucket]++;
+}
+
+// Grey what a recorded heap slot holds. A slot in a conservative object is
+// never rewritten, so while pinning its target is pinned too.
+static void gc_mark_slot(void** slot) {
+    if (gc_state.pinning) {
+        gc_object_t* holder = gc_find_object_containing(slot);
+        if (!holder || !gc_layout_of(holder)) {
+            gc_pin_object(*slot);
+        }
+    }
+    gc_mark_object(*slot);
+}
+
+// Grey what the slots recorded by the write barriers now point to: the
+// threads' buffers and the flushed remembered set. World stopped.
+static void gc_absorb_barriers(void) {
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        for (int i = 0; i < t->barrier_count; i++) {
+            gc_mark_slot(t->barrier_buf[i]);
+        }
+        t->barrier_count = 0;
+    }
+    for (size_t i = 0; i < gc_state.remset_count; i++) {
+        gc_mark_slot(gc_state.remset[i]);
+    }
+    gc_state.remset_count = 0;
+}
+
+// Clear every mark so a cycle can start over from the roots. Used when a
+// barrier buffer overflowed and some stores were not recorded.
+static void gc_clear_marks(void) {
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        for (size_t w = 0; w < region->bitmap_words; w++) {
+            uint64_t bits = region->start_bitmap[w];
+            while (bits) {
+                size_t g = w * GC_BITMAP_WORD_BITS + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                ((gc_object_t*)(region->start + g * GC_ALIGNMENT))->marked = 0;
+            }
+        }
+    }
+    gc_state.mark_stack_size = 0;
+    gc_state.mark_overflow = 0;
+    gc_state.marked_count = 0;
+    gc_state.marked_bytes = 0;
+}
+
+// Start an incremental cycle: finish any lazy sweep, grey the roots and
+// turn on black allocation and the write barrier. World stopped.
+static void gc_mark_begin(void) {
+    GC_LOG_INFO("===== INCREMENTAL MARK STARTED (collection #%d) =====",
+           gc_state.collection_count + 1);
+    gc_sweep_finish();
+    gc_state.marked_count = 0;
+    gc_state.marked_bytes = 0;
+    if (gc_state.generational) {
+        gc_clear_marks();                                  // Old objects are traced too
+    }
+    gc_state.barrier_overflow = 0;
+    gc_state.remset_count = 0;
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        t->barrier_count = 0;
+    }
+    GC_TRACE(GC_EVENT_COLLECT_BEGIN, gc_state.collection_count + 1, gc_state.heap_used);
+
+    // The cycle may end in a compaction, so it pins as it goes. Objects
+    // allocated black are pinned too: they are never scanned, and storing
+    // one needs no barrier, so nothing would redirect a conservative word
+    // that points at them.
+    gc_state.pinning = gc_state.config.compact;
+    uint64_t start_ns = gc_now_ns();
+    gc_scan_roots();
+    gc_record_phase(GC_PHASE_MARK, start_ns);
+    __atomic_store_n(&gc_state.marking, 1, __ATOMIC_RELEASE);
+}
+
+// Scan grey objects until the stack is empty or the deadline passes.
+// Returns 1 when nothing is left for this cycle but the final root rescan.
+static int gc_mark_increment(uint64_t deadline) {
+    uint64_t start = gc_now_ns();
+    size_t scanned = 0;
+
+    gc_absorb_barriers();
+    while (gc_state.mark_stack_size > 0) {
+        gc_scan_object(gc_state.mark_stack[--gc_state.mark_stack_size]);
+        if ((++scanned & 63) == 0 && gc_now_ns() >= deadline) {
+            break;
+        }
+    }
+
+    uint64_t elapsed = gc_now_ns() - start;
+    gc_record_phase(GC_PHASE_MARK, start);
+    gc_state.mark_steps++;
+    gc_state.mark_step_ns += elapsed;
+    if (elapsed > gc_state.mark_step_max_ns) {
+        gc_state.mark_step_max_ns = elapsed;
+    }
+    GC_LOG_DEBUG("Mark step: %zu objects scanned in %llu us, %zu grey left",
+           scanned, (unsigned long long)(elapsed / 1000), gc_state.mark_stack_size);
+    GC_TRACE(GC_EVENT_MARK_STEP, scanned, gc_state.mark_stack_size);
+    return gc_state.mark_stack_size == 0;
+}
+
+// Write barrier slow path: remember the heap slot a GC pointer was stored
+// to. The marker greys whatever the slot holds when it gets there, and a
+// minor collection treats it as a root. Runs inside the barrier's
+// signal-deferred section, so it must not block.
+static inline void gc_write_barrier_record(gc_thread_t* self, void** slot, void* value) {
+    // Only cheap range checks: the region table may be changing under us.
+    // gc_mark_object filters the rest when the buffer is absorbed. Stores
+    // to stacks and globals need no record; roots are rescanned anyway.
+    char* p = (char*)value;
+    char* s = (char*)slot;
+    if (p < gc_state.heap_lo || p >= gc_state.heap_hi ||
+        s < gc_state.heap_lo || s >= gc_state.heap_hi) {
+        return;
+    }
+    if (self->barrier_count < GC_BARRIER_BUFFER) {
+        self->barrier_buf[self->barrier_count++] = slot;
+    } else {
+        __atomic_store_n(&gc_state.barrier_overflow, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Move a half-full barrier buffer to the shared remembered set. Called
+// outside the deferred section, so taking the lock is safe.
+static void gc_write_barrier_flush(gc_thread_t* self) {
+    pthread_mutex_lock(&gc_state.lock);
+    if (gc_state.marking || gc_state.generational) {
+        while (gc_state.remset_count + self->barrier_count > gc_state.remset_capacity) {
+            if (!gc_sys_grow((void**)&gc_state.remset, &gc_state.remset_capacity,
+                             sizeof(void**), GC_BARRIER_BUFFER * 4)) {
+                GC_LOG_WARN("Failed to grow the remembered set");
+                gc_state.barrier_overflow = 1;
+                break;
+            }
+        }
+        if (gc_state.remset_count + self->barrier_count <= gc_state.remset_capacity) {
+            memcpy(gc_state.remset + gc_state.remset_count, self->barrier_buf,
+                   self->barrier_count * sizeof(void**));
+            gc_state.remset_count += self->barrier_count;
+        }
+    }
+    self->barrier_count = 0;
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+// Size class of a block that can satisfy a request of `size` bytes (header included)
+static inline int gc_size_class_for(size_t size) {
+    return (int)((size + GC_SIZE_CLASS_STEP - 1) / GC_SIZE_CLASS_STEP) - 1;
+}
+
+// Size class a free block of `size` bytes belongs to: the largest class it can serve
+static inline int gc_size_class_of_block(size_t size) {
+    return (int)(size / GC_SIZE_CLASS_STEP) - 1;
+}
+
+static inline size_t gc_size_class_size(int cls) {
+    return (size_t)(cls + 1) * GC_SIZE_CLASS_STEP;
+}
+
+// Free bitmap helpers. A block's free bit is set exactly while it is on a
+// bucket or a large bin, so a neighbour can be recognised by address.
+// Free lists only change under gc_state.lock or with the world stopped.
+static inline void gc_free_bit_set(void* ptr, int is_free) {
+    gc_region_t* region = gc_region_of(ptr);
+    size_t g = gc_granule_of(region, ptr);
+    uint64_t mask = (uint64_t)1 << (g % GC_BITMAP_WORD_BITS);
+    if (is_free) {
+        region->free_bitmap[g / GC_BITMAP_WORD_BITS] |= mask;
+    } else {
+        region->free_bitmap[g / GC_BITMAP_WORD_BITS] &= ~mask;
+    }
+}
+
+static inline int gc_free_bit(gc_region_t* region, void* ptr) {
+    size_t g = gc_granule_of(region, ptr);
+    return (region->free_bitmap[g / GC_BITMAP_WORD_BITS] >> (g % GC_BITMAP_WORD_BITS)) & 1;
+}
+
+// Bin of a large block or request: floor(log2(size)) past the class limit
+static inline int gc_large_bin_of(size_t size) {
+    int bin = 63 - __builtin_clzll(size) - GC_LARGE_BIN_SHIFT;
+    return bin < GC_NUM_LARGE_BINS ? bin : GC_NUM_LARGE_BINS - 1;
+}
+
+// Unlink a block from the list whose head is given
+static void gc_unlink_block(gc_free_block_t** head, gc_free_block_t* block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        *head = block->next;
+    }
+    if (block->next) block->next->prev = block->prev;
+    gc_free_bit_set(block, 0);
+}
+
+// Push a small block onto its size class bucket
+static void gc_push_size_class(void* ptr, size_t size) {
+    int cls = gc_size_class_of_block(size);
+    gc_free_block_t* block = (gc_free_block_t*)ptr;
+    block->size = size;
+    block->prev = NULL;
+    block->next = gc_state.size_classes[cls];
+    if (block->next) block->next->prev = block;
+    gc_state.size_classes[cls] = block;
+    gc_state.size_class_mask |= (uint64_t)1 << cls;
+    gc_state.class_free_count[cls]++;
+    gc_free_bit_set(block, 1);
+}
+
+// Push a large block onto the front of its bin
+static void gc_push_large(void* ptr, size_t size) {
+    int bin = gc_large_bin_of(size);
+    gc_free_block_t* block = (gc_free_block_t*)ptr;
+    block->size = size;
+    block->prev = NULL;
+    block->next = gc_state.large_bins[bin];
+    if (block->next) block->next->prev = block;
+    gc_state.large_bins[bin] = block;
+    gc_state.large_bin_mask |= (uint64_t)1 << bin;
+    gc_free_bit_set(block, 1);
+}
+
+// Take a listed block off its bucket or bin, whichever its size puts it on
+static void gc_take_free_block(gc_free_block_t* block) {
+    if (block->size <= GC_SIZE_CLASS_MAX) {
+        int cls = gc_size_class_of_block(block->size);
+        gc_unlink_block(&gc_state.size_classes[cls], block);
+        gc_state.class_free_count[cls]--;
+        if (!gc_state.size_classes[cls]) gc_state.size_class_mask &= ~((uint64_t)1 << cls);
+    } else {
+        int bin = gc_large_bin_of(block->size);
+        gc_unlink_block(&gc_state.large_bins[bin], block);
+        if (!gc_state.large_bins[bin]) gc_state.large_bin_mask &= ~((uint64_t)1 << bin);
+    }
+}
+
+// Return a free block to the bucket or bin that matches its size. O(1).
+static void gc_release_block(void* ptr, size_t size) {
+    if (size < sizeof(gc_object_t) + GC_ALIGNMENT) {
+        GC_LOG_TRACE("Block too small to reuse: %p, %zu bytes", ptr, size);
+        return;
+    }
+    if (size <= GC_SIZE_CLASS_MAX) {
+        gc_push_size_class(ptr, size);
+    } else {
+        gc_push_large(ptr, size);
+    }
+}
+
+// Merge free blocks that touch. Each region's free bitmap is walked in
+// address order; a block that absorbs its neighbours leaves its list and
+// goes back to the one its new size belongs to. Free bits of a region that
+// is still being swept are only current below sweep_word.
+static void gc_coalesce_free_blocks(void) {
+    GC_LOG_DEBUG("Coalescing free blocks");
+    uint64_t start_ns = gc_now_ns();
+    int coalesced_count = 0;
+
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        size_t end_word = region->needs_sweep ? region->sweep_word : region->bitmap_words;
+        gc_free_block_t* run = NULL;
+        int run_taken = 0;                                 // run is off its list and growing
+
+        for (size_t w = 0; w < end_word; w++) {
+            uint64_t bits = region->free_bitmap[w];
+            while (bits) {
+                unsigned bit = __builtin_ctzll(bits);
+                bits &= bits - 1;
+                gc_free_block_t* block = (gc_free_block_t*)(region->start + (w * GC_BITMAP_WORD_BITS + bit) * GC_ALIGNMENT);
+
+                if (run && (char*)run + run->size == (char*)block) {
+                    GC_LOG_TRACE("Coalescing blocks: %p (size %zu) + %p (size %zu)",
+                           run, run->size, block, block->size);
+                    if (!run_taken) {
+                        gc_take_free_block(run);
+                        run_taken = 1;
+                    }
+                    gc_take_free_block(block);
+                    run->size += block->size;
+                    coalesced_count++;
+                    continue;
+                }
+                if (run_taken) gc_release_block(run, run->size);
+                run = block;
+                run_taken = 0;
+            }
+        }
+        if (run_taken) gc_release_block(run, run->size);
+    }
+
+    GC_LOG_DEBUG("Coalescing complete: %d blocks merged", coalesced_count);
+    gc_record_phase(GC_PHASE_COALESCE, start_ns);
+}
+
+// Carve `size` bytes off the front of a block, returning the rest to the
+// free lists. Returns the number of bytes actually handed out.
+static size_t gc_split_block(gc_free_block_t* block, size_t size) {
+    size_t remainder = block->size - size;
+    if (remainder < sizeof(gc_object_t) + GC_ALIGNMENT) {
+        GC_LOG_TRACE("Using entire block: %p, size %zu", block, block->size);
+        return block->size;
+    }
+
+    GC_LOG_TRACE("Splitting block: using %zu bytes, leaving %zu bytes", size, remainder);
+    gc_release_block((char*)block + size, remainder);
+    return size;
+}
+
+// Find a large block of at least `size` bytes: first fit among the first
+// GC_LARGE_BIN_SCAN blocks of its own bin, then the front of the next
+// non-empty bin, where every block is big enough, and only then the rest of
+// its own bin. Any large block fits a small request.
+static gc_free_block_t* gc_find_large(size_t size) {
+    if (size <= GC_SIZE_CLASS_MAX) {
+        return gc_state.large_bin_mask ? gc_state.large_bins[__builtin_ctzll(gc_state.large_bin_mask)] : NULL;
+    }
+
+    int bin = gc_large_bin_of(size);
+    gc_free_block_t* block = gc_state.large_bins[bin];
+    for (int i = 0; block && i < GC_LARGE_BIN_SCAN; i++, block = block->next) {
+        if (block->size >= size) return block;
+    }
+
+    uint64_t above = gc_state.large_bin_mask & (~(uint64_t)0 << bin << 1);
+    if (above) return gc_state.large_bins[__builtin_ctzll(above)];
+
+    for (; block; block = block->next) {
+        if (block->size >= size) return block;
+    }
+    return NULL;
+}
+
+static void* gc_alloc_large(size_t size, size_t* block_size) {
+    gc_free_block_t* block = gc_find_large(size);
+    if (!block) return NULL;
+
+    GC_LOG_TRACE("Found suitable block: %p, size %zu", block, block->size);
+    gc_take_free_block(block);
+    *block_size = gc_split_block(block, size);
+    return block;
+}
+
+// Allocate from free list. `size` includes the object header; on success
+// `block_size` receives the number of bytes the caller now owns.
+static void* gc_alloc_from_freelist(size_t size, size_t* block_size) {
+    GC_LOG_TRACE("Allocating from free list: %zu bytes", size);
+
+    if (size <= GC_SIZE_CLASS_MAX) {
+        int cls = gc_size_class_for(size);
+        if (gc_state.size_classes[cls]) {
+            gc_free_block_t* block = gc_state.size_classes[cls];
+            gc_take_free_block(block);
+            GC_LOG_TRACE("Size class %d hit: %p, size %zu", cls, block, block->size);
+            *block_size = gc_split_block(block, size);
+            return block;
         }
+
+        // Empty bucket: split a block from the next bigger class, then fall
+        // back to the large bins
+        uint64_t larger = gc_state.size_class_mask & (~(uint64_t)0 << cls << 1);
+        if (larger) {
+            int i = __builtin_ctzll(larger);
+            gc_free_block_t* block = gc_state.size_classes[i];
+            gc_take_free_block(block);
+            GC_LOG_TRACE("Size class %d miss, splitting class %d block %p", cls, i, block);
+            *block_size = gc_split_block(block, size);
+            return block;
+        }
+    }
+
+    void* ptr = gc_alloc_large(size, block_size);
+    if (!ptr) {
+        GC_LOG_TRACE("No suitable block found in free list");
     }
+    return ptr;
+}
+
+// Large gaps found by a sweep, per bin in address order. They go on the
+// front of the bins once the sweep is done, so allocation keeps favouring
+// the low end of the heap.
+typedef struct {
+    gc_free_block_t* head[GC_NUM_LARGE_BINS];
+    gc_free_block_t* tail[GC_NUM_LARGE_BINS];
+} gc_free_chain_t;
+
+static void gc_splice_chain(gc_free_chain_t* chain) {
+    for (int bin = 0; bin < GC_NUM_LARGE_BINS; bin++) {
+        if (!chain->head[bin]) continue;
+        chain->tail[bin]->next = gc_state.large_bins[bin];
+        if (gc_state.large_bins[bin]) gc_state.large_bins[bin]->prev = chain->tail[bin];
+        gc_state.large_bins[bin] = chain->head[bin];
+        gc_state.large_bin_mask |= (uint64_t)1 << bin;
+    }
+}
+
+// Return the gap between two live objects to the free lists. Gaps come in
+// address order, so large ones are appended to the chain of their bin.
+static void gc_sweep_gap(char* start, char* end, gc_free_chain_t* chain) {
+    size_t size = (size_t)(end - start);
+    if (size < sizeof(gc_object_t) + GC_ALIGNMENT) {
+        if (size > 0) GC_LOG_TRACE("Gap too small to reuse: %p, %zu bytes", start, size);
+        return;
+    }
+
+    if (size <= GC_SIZE_CLASS_MAX) {
+        gc_push_size_class(start, size);
+        return;
+    }
+
+    int bin = gc_large_bin_of(size);
+    gc_free_block_t* block = (gc_free_block_t*)start;
+    block->size = size;
+    block->next = NULL;
+    block->prev = chain->tail[bin];
+    if (chain->tail[bin]) {
+        chain->tail[bin]->next = block;
+    } else {
+        chain->head[bin] = block;
+    }
+    chain->tail[bin] = block;
+    gc_free_bit_set(block, 1);
+}
+
+typedef struct {
+    int objects_swept;
+    int objects_kept;
+    size_t bytes_freed;
+} gc_sweep_totals_t;
+
+// Sweep up to `max_words` bitmap words of a region, resuming where the last
+// call stopped. Dead objects lose their start bit, the gaps between live
+// objects become free blocks and marks are reset. The free bits of the
+// words swept are rebuilt; past sweep_word they are stale until then.
+// Returns 1 once the region is done.
+static int gc_sweep_region(gc_region_t* region, size_t max_words,
+                           gc_free_chain_t* chain, gc_sweep_totals_t* totals) {
+    size_t end_word = region->bitmap_words;
+    if (max_words < end_word - region->sweep_word) {
+        end_word = region->sweep_word + max_words;
+    }
+    memset(&region->free_bitmap[region->sweep_word], 0,
+           (end_word - region->sweep_word) * sizeof(uint64_t));
+
+    for (size_t w = region->sweep_word; w < end_word; w++) {
+        uint64_t bits = region->start_bitmap[w];
+        while (bits) {
+            unsigned bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            gc_object_t* obj = (gc_object_t*)(region->start + (w * GC_BITMAP_WORD_BITS + bit) * GC_ALIGNMENT);
+            size_t total_size = sizeof(gc_object_t) + obj->size;
+
+            if (!obj->marked) {
+                GC_LOG_TRACE("Sweeping unmarked object: %p, size %zu", obj->data, obj->size);
+                region->start_bitmap[w] &= ~((uint64_t)1 << bit);
+                totals->objects_swept++;
+                totals->bytes_freed += total_size;
+                continue;
+            }
+
+            GC_LOG_TRACE("Keeping marked object: %p, size %zu", obj->data, obj->size);
+
+            // Reset mark for next collection; survivors stay marked (old)
+            // in generational mode
+            obj->marked = gc_state.generational;
+            obj->flags &= ~GC_FLAG_PINNED;
+            gc_sweep_gap(region->sweep_cursor, (char*)obj, chain);
+            region->sweep_cursor = (char*)obj + total_size;
+
+            if (total_size <= GC_SIZE_CLASS_MAX) {
+                gc_state.class_live_count[gc_size_class_for(total_size)]++;
+            }
+            region->live_bytes += total_size;
+            totals->objects_kept++;
+        }
+    }
+    region->sweep_word = end_word;
+
+    if (end_word < region->bitmap_words) {
+        return 0;
+    }
+    gc_sweep_gap(region->sweep_cursor, region->start + region->size, chain);
+    region->needs_sweep = 0;
+    return 1;
+}
+
+// Forget every free block and queue all regions for sweeping. The world is
+// stopped and marking is complete.
+static void gc_sweep_begin(void) {
+    for (int i = 0; i < GC_NUM_LARGE_BINS; i++) {
+        gc_state.large_bins[i] = NULL;
+    }
+    gc_state.large_bin_mask = 0;
+    for (int i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+        gc_state.size_classes[i] = NULL;
+        gc_state.class_free_count[i] = 0;
+        gc_state.class_live_count[i] = 0;
+    }
+    gc_state.size_class_mask = 0;
+
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        region->needs_sweep = 1;
+        region->sweep_word = 0;
+        region->sweep_cursor = region->start;
+        region->live_bytes = 0;
+    }
+    gc_state.sweep_pending = gc_state.region_count;
+}
+
+static void gc_sweep(void) {
+    GC_LOG_DEBUG("Starting sweep phase");
+    uint64_t start_ns = gc_now_ns();
     
-    GC_LOG("Sweep phase complete: %d objects swept (%zu bytes), %d objects kept", 
-           objects_swept, bytes_freed, objects_kept);
+    gc_free_chain_t chain = {{NULL}, {NULL}};
+    gc_sweep_totals_t totals = {0, 0, 0};
+    size_t bytes_kept = 0;
+
+    gc_sweep_begin();
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        gc_sweep_region(region, region->bitmap_words, &chain, &totals);
+        bytes_kept += region->live_bytes;
+    }
+    gc_splice_chain(&chain);
+    gc_state.sweep_pending = 0;
     
-    // Coalesce adjacent free blocks
-    gc_coalesce_freelist();
+    gc_state.heap_used = bytes_kept;
+    gc_state.object_count = totals.objects_kept;
+
+    GC_LOG_DEBUG("Sweep phase complete: %d objects swept (%zu bytes), %d objects kept", 
+           totals.objects_swept, totals.bytes_freed, totals.objects_kept);
+    gc_measure_fragmentation();
+    gc_record_phase(GC_PHASE_SWEEP, start_ns);
+    GC_TRACE(GC_EVENT_SWEEP_END, totals.objects_swept, totals.bytes_freed);
+}
+
+// Sweep one bounded slice of the regions left by a lazy collection, in
+// address order. Returns 0 if there was nothing left to sweep.
+static int gc_sweep_slice(void) {
+    if (!gc_state.sweep_pending) {
+        return 0;
+    }
+
+    uint64_t start_ns = gc_now_ns();
+    size_t budget = GC_SWEEP_SLICE / (GC_ALIGNMENT * GC_BITMAP_WORD_BITS);
+    if (budget == 0) budget = 1;
+    size_t covered = 0;
+    gc_free_chain_t chain = {{NULL}, {NULL}};
+    gc_sweep_totals_t totals = {0, 0, 0};
+
+    for (int r = 0; r < gc_state.region_count && budget > 0; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        if (!region->needs_sweep) continue;
+
+        size_t before = region->sweep_word;
+        if (gc_sweep_region(region, budget, &chain, &totals)) {
+            gc_state.sweep_pending--;
+        }
+        size_t words = region->sweep_word - before;
+        budget -= words < budget ? words : budget;
+        covered += words * GC_ALIGNMENT * GC_BITMAP_WORD_BITS;
+    }
+
+    gc_splice_chain(&chain);
+
+    gc_state.sweep_slices++;
+    gc_state.sweep_slice_bytes += covered;
+    gc_state.sweep_slice_freed += totals.bytes_freed;
+    gc_state.sweep_last_slice_bytes = covered;
+    gc_record_phase(GC_PHASE_SWEEP, start_ns);
+    GC_LOG_DEBUG("Sweep slice: %zu bytes covered, %d objects swept (%zu bytes), %d regions left",
+           covered, totals.objects_swept, totals.bytes_freed, gc_state.sweep_pending);
+
+    if (!gc_state.sweep_pending) {
+        gc_measure_fragmentation();
+        GC_TRACE(GC_EVENT_SWEEP_END, totals.objects_swept, gc_state.sweep_slice_freed);
+        // Every free block is known again, so empty regions can go back.
+        // The target stays the one set after marking.
+        int released = gc_release_empty_regions();
+        if (released) {
+            GC_LOG_INFO("Lazy sweep done: %d empty regions released", released);
+        }
+    }
+    return 1;
+}
+
+// Sweep whatever a lazy collection left behind. Marking needs every
+// surviving mark cleared first.
+static void gc_sweep_finish(void) {
+    while (gc_sweep_slice()) {}
+}
+
+// Free list allocation that sweeps more of the heap on a miss
+static void* gc_alloc_or_sweep(size_t size, size_t* block_size) {
+    void* ptr = gc_alloc_from_freelist(size, block_size);
+    while (!ptr && gc_sweep_slice()) {
+        ptr = gc_alloc_from_freelist(size, block_size);
+    }
+    return ptr;
+}
+
+// Page-align a region request
+static size_t gc_round_to_pages(size_t size) {
+    return (size + gc_state.page_size - 1) & ~(gc_state.page_size - 1);
+}
+
+// Map a new region and hand its memory to the free lists
+static gc_region_t* gc_add_region(size_t size) {
+    size = gc_round_to_pages(size);
+    if (gc_state.config.max_heap_size &&
+        gc_state.heap_size + size > gc_state.config.max_heap_size) {
+        GC_LOG_WARN("Region of %zu bytes would exceed max heap size %zu",
+               size, gc_state.config.max_heap_size);
+        return NULL;
+    }
+
+    if (gc_state.region_count == gc_state.region_capacity) {
+        int new_capacity = gc_state.region_capacity ? gc_state.region_capacity * 2 : 16;
+        gc_region_t** table = gc_sys_alloc(new_capacity * sizeof(gc_region_t*));
+        if (!table) return NULL;
+        if (gc_state.regions) {
+            memcpy(table, gc_state.regions, gc_state.region_count * sizeof(gc_region_t*));
+            munmap(gc_state.regions, gc_state.region_capacity * sizeof(gc_region_t*));
+        }
+        gc_state.regions = table;
+        gc_state.region_capacity = new_capacity;
+    }
+
+    char* start = gc_sys_alloc(size);
+    if (!start) {
+        GC_LOG_WARN("Failed to map region of %zu bytes", size);
+        return NULL;
+    }
+    size_t bitmap_words = GC_BITMAP_WORDS(size);
+    size_t meta_size = sizeof(gc_region_t) + 2 * bitmap_words * sizeof(uint64_t);
+    gc_region_t* region = gc_sys_alloc(meta_size);
+    if (!region) {
+        munmap(start, size);
+        return NULL;
+    }
+    region->start = start;
+    region->size = size;
+    region->live_bytes = 0;
+    region->start_bitmap = (uint64_t*)(region + 1);
+    region->free_bitmap = region->start_bitmap + bitmap_words;
+    region->bitmap_words = bitmap_words;
+    region->meta_size = meta_size;
+
+    // Keep the table sorted by address for gc_region_of
+    int i = gc_state.region_count;
+    while (i > 0 && gc_state.regions[i - 1]->start > start) {
+        gc_state.regions[i] = gc_state.regions[i - 1];
+        i--;
+    }
+    gc_state.regions[i] = region;
+    gc_state.region_count++;
+    gc_state.last_region = NULL;
+    GC_TRACE(GC_EVENT_REGION_MAP, start, size);
+
+    if (!gc_state.heap_lo || start < gc_state.heap_lo) gc_state.heap_lo = start;
+    if (start + size > gc_state.heap_hi) gc_state.heap_hi = start + size;
+    gc_state.heap_size += size;
+
+    gc_release_block(start, size);
+
+    GC_LOG_INFO("Mapped region %p (%zu bytes), heap now %zu bytes in %d regions",
+           start, size, gc_state.heap_size, gc_state.region_count);
+    return region;
+}
+
+// Unmap empty regions the heap target no longer needs. Empty regions that
+// are kept have their pages returned to the kernel; only the free block
+// header in the first page stays. A region counts as empty only if a single
+// free block covers all of it. Returns the number of regions released.
+static int gc_release_empty_regions(void) {
+    // Drop the free blocks of regions that are going away
+    int released = 0;
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        if (region->needs_sweep || !gc_free_bit(region, region->start)) continue;
+        gc_free_block_t* block = (gc_free_block_t*)region->start;
+        if (block->size != region->size) continue;
+
+        if (gc_state.region_count - released > 1 &&
+            gc_state.heap_size - region->size >= gc_state.heap_target) {
+            gc_take_free_block(block);
+            gc_state.heap_size -= region->size;
+            region->live_bytes = (size_t)-1;           // Marks it for unmapping
+            released++;
+            continue;
+        }
+        if (region->size > gc_state.page_size) {
+            madvise(region->start + gc_state.page_size,
+                    region->size - gc_state.page_size, MADV_DONTNEED);
+        }
+    }
+
+    if (released) {
+        int kept = 0;
+        for (int i = 0; i < gc_state.region_count; i++) {
+            gc_region_t* region = gc_state.regions[i];
+            if (region->live_bytes == (size_t)-1) {
+                GC_LOG_INFO("Unmapping empty region %p (%zu bytes)", region->start, region->size);
+                GC_TRACE(GC_EVENT_REGION_UNMAP, region->start, region->size);
+                munmap(region->start, region->size);
+                munmap(region, region->meta_size);
+                continue;
+            }
+            gc_state.regions[kept++] = region;
+        }
+        gc_state.region_count = kept;
+        gc_state.last_region = NULL;
+        gc_state.heap_lo = gc_state.regions[0]->start;
+        gc_state.heap_hi = gc_state.regions[kept - 1]->start + gc_state.regions[kept - 1]->size;
+    }
+    return released;
+}
+
+// Measure the collector's share of the time since the last full
+// collection and move the pace that scales the next trigger.
+static void gc_update_pace(void) {
+    uint64_t now = gc_now_ns();
+    uint64_t gc_ns = 0;
+    for (int p = 0; p < GC_PHASE_COUNT; p++) {
+        gc_ns += gc_state.pause_total_ns[p];
+    }
+    uint64_t wall = now - gc_state.pace_start_ns;
+    if (wall) {
+        gc_state.gc_cpu_share = (double)(gc_ns - gc_state.pace_start_gc_ns) / wall;
+    }
+
+    double target = gc_state.config.cpu_target;
+    if (target <= 0) {
+        gc_state.pace = 1.0;
+    } else if (gc_state.gc_cpu_share > target) {
+        gc_state.pace *= 1.5;
+        if (gc_state.pace > GC_PACE_MAX) gc_state.pace = GC_PACE_MAX;
+    } else if (gc_state.gc_cpu_share < target / 2) {
+        gc_state.pace /= 1.25;
+        if (gc_state.pace < 1.0) gc_state.pace = 1.0;
+    }
+    gc_state.pace_start_ns = now;
+    gc_state.pace_start_gc_ns = gc_ns;
+}
+
+// Whether handing out size more bytes takes the heap past the trigger
+static inline int gc_past_trigger(size_t size) {
+    return gc_state.heap_used + size > gc_state.next_trigger;
+}
+
+// Recompute the trigger and heap target from live bytes, release what the
+// heap no longer needs and grow towards the target.
+static void gc_resize_heap(void) {
+    double trigger = (double)gc_state.heap_used * gc_state.config.growth_factor * gc_state.pace;
+    if (trigger < (double)gc_state.config.min_heap_size * GC_THRESHOLD) {
+        trigger = (double)gc_state.config.min_heap_size * GC_THRESHOLD;
+    }
+    if (gc_state.config.max_heap_size && trigger > (double)gc_state.config.max_heap_size) {
+        trigger = (double)gc_state.config.max_heap_size;
+    }
+    gc_state.next_trigger = (size_t)trigger;
+
+    double target = trigger;
+    if (target < (double)gc_state.config.min_heap_size) {
+        target = (double)gc_state.config.min_heap_size;
+    }
+    if (gc_state.config.max_heap_size && target > (double)gc_state.config.max_heap_size) {
+        target = (double)gc_state.config.max_heap_size;
+    }
+    gc_state.heap_target = (size_t)target;
+
+    int released = gc_release_empty_regions();
+
+    // Grow ahead of demand so the next cycles are spaced by the target, not
+    // by whatever the heap happened to be.
+    while (gc_state.heap_size < gc_state.heap_target) {
+        size_t size = gc_state.config.region_size;
+        if (gc_state.heap_target - gc_state.heap_size < size) {
+            size = gc_state.heap_target - gc_state.heap_size;
+        }
+        if (!gc_add_region(size)) break;
+    }
+
+    GC_LOG_INFO("Trigger %zu bytes (pace %.2f), heap target %zu bytes: %zu bytes in %d regions (%d released)",
+           gc_state.next_trigger, gc_state.pace, gc_state.heap_target,
+           gc_state.heap_size, gc_state.region_count, released);
+}
+
+//==============================================================================
+// Compaction
+//==============================================================================
+
+// Fragmentation is the share of free bytes in holes smaller than
+// GC_COMPACT_HOLE, counting gaps too small to reuse: 0 when free memory is
+// all in big blocks, close to 1 when it is all holes. The largest block is
+// no measure here, since no block outgrows its region. Needs complete free
+// lists, so it is taken at the end of a sweep.
+static void gc_measure_fragmentation(void) {
+    size_t largest = 0;
+    size_t usable = 0;
+    for (int bin = 0; bin < GC_NUM_LARGE_BINS; bin++) {
+        for (gc_free_block_t* block = gc_state.large_bins[bin]; block; block = block->next) {
+            if (block->size > largest) largest = block->size;
+            if (block->size >= GC_COMPACT_HOLE) usable += block->size;
+        }
+    }
+    for (int i = GC_NUM_SIZE_CLASSES - 1; i >= 0 && !largest; i--) {
+        if (gc_state.size_classes[i]) largest = gc_size_class_size(i);
+    }
+
+    size_t free_bytes = gc_state.heap_size > gc_state.heap_used ?
+                        gc_state.heap_size - gc_state.heap_used : 0;
+    gc_state.largest_free = largest;
+    gc_state.fragmentation = free_bytes > usable ? 1.0 - (double)usable / free_bytes : 0.0;
+}
+
+// Where ptr points after compaction: the same offset in the copy if it
+// points into an evacuated object, else ptr itself
+static void* gc_forward(void* ptr) {
+    gc_region_t* region = gc_region_of(ptr);
+    if (!region || !region->evacuating) return ptr;
+
+    gc_object_t* target = gc_find_object_containing(ptr);
+    if (!target || !(target->flags & GC_FLAG_FORWARDED)) return ptr;
+    return *(char**)target->data + ((char*)ptr - target->data);
+}
+
+// Point every pointer field of a surviving typed object that refers into
+// an evacuated object at the same offset in its copy. Conservative objects
+// are never rewritten: their targets were pinned instead.
+static void gc_fix_object(gc_object_t* obj) {
+    const gc_layout_t* layout = gc_layout_of(obj);
+    if (!layout) return;                                   // Atomic or conservative
+    uintptr_t* data = (uintptr_t*)obj->data;
+    size_t word_count = obj->size / sizeof(uintptr_t);
+
+    for (size_t i = 0; i < word_count; i++) {
+        if (!gc_layout_has_pointer(layout, i)) continue;
+        uintptr_t value = data[i];
+        if (value % sizeof(void*) != 0) continue;
+        data[i] = (uintptr_t)gc_forward((void*)value);
+    }
+}
+
+// The finalization tables are not scanned, so compaction redirects them
+// itself. Weak references are atomic, which also hides their targets from
+// gc_fix_object.
+static void gc_fix_finalization(void) {
+    for (size_t i = 0; i < gc_state.finalizer_count; i++) {
+        gc_state.finalizers[i].obj = gc_forward(gc_state.finalizers[i].obj);
+    }
+    for (size_t i = 0; i < gc_state.finalize_queue_count; i++) {
+        gc_state.finalize_queue[i].obj = gc_forward(gc_state.finalize_queue[i].obj);
+    }
+    for (size_t i = 0; i < gc_state.weak_count; i++) {
+        gc_weak_t* weak = gc_forward(gc_state.weak_refs[i]);
+        if (weak->target) {
+            weak->target = gc_forward(weak->target);
+        }
+        gc_state.weak_refs[i] = weak;
+    }
+}
+
+// Root visitor used after evacuation
+static void gc_fix_root(void** slot) {
+    *slot = gc_forward(*slot);
+}
+
+// Precise roots were not pinned, so they may now point at moved objects
+static void gc_fix_roots(void) {
+    for (size_t i = 0; i < gc_state.root_count; i++) {
+        if (gc_state.roots[i].precise) {
+            gc_fix_root((void**)gc_state.roots[i].start);
+        }
+    }
+    if (gc_state.root_scanner) {
+        gc_state.root_scanner(gc_fix_root, gc_state.root_scanner_data);
+    }
+}
+
+// Visit every marked object that was not moved away
+#define GC_FOR_EACH_LIVE(region, obj, body) \
+    for (size_t gc_w_ = 0; gc_w_ < (region)->bitmap_words; gc_w_++) { \
+        uint64_t gc_bits_ = (region)->start_bitmap[gc_w_]; \
+        while (gc_bits_) { \
+            size_t gc_g_ = gc_w_ * GC_BITMAP_WORD_BITS + __builtin_ctzll(gc_bits_); \
+            gc_bits_ &= gc_bits_ - 1; \
+            gc_object_t* obj = (gc_object_t*)((region)->start + gc_g_ * GC_ALIGNMENT); \
+            if (!obj->marked || (obj->flags & GC_FLAG_FORWARDED)) continue; \
+            body \
+        } \
+    }
+
+// Mostly-copying compaction. Marking is complete and nothing is swept yet.
+// Survivors of sparse regions are copied into fresh regions, leaving a
+// forwarding pointer behind, except those pinned by an ambiguous reference.
+// Every typed survivor is then scanned once to redirect its pointers, and the
+// originals are unmarked so the sweep frees them; the emptied regions go
+// back with the other empty ones. World stopped.
+static void gc_compact(void) {
+    uint64_t start_ns = gc_now_ns();
+
+    // Pick the regions whose live data is sparse and not all pinned
+    int candidates = 0;
+    for (int r = 0; r < gc_state.region_count; r++) {
+        gc_region_t* region = gc_state.regions[r];
+        size_t live = 0;
+        size_t movable = 0;
+        GC_FOR_EACH_LIVE(region, obj, {
+            size_t total = sizeof(gc_object_t) + obj->size;
+            live += total;
+            if (!(obj->flags & GC_FLAG_PINNED) && obj->size >= sizeof(void*)) {
+                movable += total;
+            }
+        })
+        region->evacuating = movable > 0 && live < region->size * GC_COMPACT_LIVE_RATIO;
+        candidates += region->evacuating;
+    }
+    if (!candidates) {
+        GC_LOG_DEBUG("Compaction: no sparse regions to evacuate");
+        return;
+    }
+
+    // Adding to-space regions reorders the table, so work from a snapshot
+    gc_region_t** from = gc_sys_alloc(candidates * sizeof(gc_region_t*));
+    if (!from) {
+        for (int r = 0; r < gc_state.region_count; r++) gc_state.regions[r]->evacuating = 0;
+        return;
+    }
+    int n = 0;
+    for (int r = 0; r < gc_state.region_count; r++) {
+        if (gc_state.regions[r]->evacuating) from[n++] = gc_state.regions[r];
+    }
+
+    gc_region_t* to = NULL;
+    char* to_cur = NULL;
+    char* to_end = NULL;
+    size_t moved = 0;
+    size_t moved_bytes = 0;
+    size_t pinned = 0;
+    int full = 0;
+    for (int i = 0; i < n; i++) {
+        GC_FOR_EACH_LIVE(from[i], obj, {
+            if (full) continue;
+            if ((obj->flags & GC_FLAG_PINNED) || obj->size < sizeof(void*)) {
+                pinned++;
+                continue;
+            }
+            size_t total = sizeof(gc_object_t) + obj->size;
+            if ((size_t)(to_end - to_cur) < total) {
+                size_t size = gc_state.config.region_size;
+                if (size < total + GC_ALIGNMENT) size = total + GC_ALIGNMENT;
+                to = gc_add_region(size);
+                if (!to) {
+                    GC_LOG_WARN("Compaction stopped: no room for a to-space region");
+                    full = 1;
+                    continue;
+                }
+                gc_take_free_block((gc_free_block_t*)to->start); // The sweep frees what is left
+                to_cur = to->start;
+                to_end = to->start + to->size;
+            }
+
+            gc_object_t* copy = (gc_object_t*)to_cur;
+            memcpy(copy, obj, total);
+            copy->flags = obj->flags & GC_FLAG_FINALIZER;
+            gc_bitmap_set(to, copy);
+            to_cur += total;
+
+            obj->flags |= GC_FLAG_FORWARDED;
+            *(char**)obj->data = copy->data;
+            moved++;
+            moved_bytes += total;
+        })
+    }
+
+    // Redirect typed fields and precise roots; ambiguous words never
+    // point at moved objects
+    if (moved) {
+        for (int r = 0; r < gc_state.region_count; r++) {
+            gc_region_t* region = gc_state.regions[r];
+            GC_FOR_EACH_LIVE(region, obj, {
+                gc_fix_object(obj);
+            })
+        }
+        gc_fix_finalization();
+        gc_fix_roots();
+    }
+
+    // The originals are garbage now
+    for (int i = 0; i < n; i++) {
+        gc_region_t* region = from[i];
+        for (size_t w = 0; w < region->bitmap_words; w++) {
+            uint64_t bits = region->start_bitmap[w];
+            while (bits) {
+                size_t g = w * GC_BITMAP_WORD_BITS + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                gc_object_t* obj = (gc_object_t*)(region->start + g * GC_ALIGNMENT);
+                if (obj->flags & GC_FLAG_FORWARDED) {
+                    obj->marked = 0;
+                    obj->flags = 0;
+                }
+            }
+        }
+        region->evacuating = 0;
+    }
+    munmap(from, candidates * sizeof(gc_region_t*));
+
+    gc_state.compactions++;
+    gc_state.evacuated_objects += moved;
+    gc_state.evacuated_bytes += moved_bytes;
+    gc_state.pinned_objects += pinned;
+    gc_record_phase(GC_PHASE_COMPACT, start_ns);
+    GC_LOG_INFO("Compaction: %zu objects (%zu bytes) evacuated from %d regions, %zu pinned, %.3f ms",
+           moved, moved_bytes, n, pinned, (gc_now_ns() - start_ns) / 1e6);
+}
+
+// Batch pass over weak references and finalizers once marking is complete,
+// before anything is moved or swept. World stopped. Weak references to
+// unmarked objects are cleared first. Unmarked objects with a finalizer are
+// then queued and marked again, with everything they reach, so the
+// finalizer sees them intact; a later collection frees them once nothing
+// refers to them. The queue is run after the world restarts.
+static void gc_process_finalization(void) {
+    size_t kept = 0;
+    for (size_t i = 0; i < gc_state.weak_count; i++) {
+        gc_weak_t* weak = gc_state.weak_refs[i];
+        if (!gc_object_of(weak)->marked) continue;         // The reference itself died
+        if (weak->target) {
+            gc_object_t* target = gc_find_object_containing(weak->target);
+            if (target && !target->marked) {
+                weak->target = NULL;
+                gc_state.weak_cleared++;
+            }
+        }
+        gc_state.weak_refs[kept++] = weak;
+    }
+    gc_state.weak_count = kept;
+
+    if (!gc_state.finalizer_count) return;
+    while (gc_state.finalize_queue_count + gc_state.finalizer_count >
+           gc_state.finalize_queue_capacity) {
+        if (!gc_sys_grow((void**)&gc_state.finalize_queue, &gc_state.finalize_queue_capacity,
+                         sizeof(gc_finalizer_t), 64)) {
+            // Keep every candidate alive and try again next time
+            GC_LOG_WARN("Failed to grow the finalization queue, deferring finalizers");
+            for (size_t i = 0; i < gc_state.finalizer_count; i++) {
+                gc_mark_object(gc_state.finalizers[i].obj);
+            }
+            gc_mark_drain();
+            return;
+        }
+    }
+
+    // Decide for every entry before reviving any: an object reachable only
+    // from another finalizable one is just as dead
+    size_t first = gc_state.finalize_queue_count;
+    kept = 0;
+    for (size_t i = 0; i < gc_state.finalizer_count; i++) {
+        gc_finalizer_t entry = gc_state.finalizers[i];
+        gc_object_t* obj = gc_object_of(entry.obj);
+        if (obj->marked) {
+            gc_state.finalizers[kept++] = entry;
+            continue;
+        }
+        obj->flags &= ~GC_FLAG_FINALIZER;
+        gc_state.finalize_queue[gc_state.finalize_queue_count++] = entry;
+    }
+    gc_state.finalizer_count = kept;
+
+    for (size_t i = first; i < gc_state.finalize_queue_count; i++) {
+        gc_mark_object(gc_state.finalize_queue[i].obj);
+    }
+    gc_mark_drain();
+    if (gc_state.finalize_queue_count > first) {
+        GC_LOG_DEBUG("Queued %zu finalizers", gc_state.finalize_queue_count - first);
+    }
+}
+
+// Take every thread's TLAB away. The world is stopped, so nobody is inside
+// the fast path; the unused tails come back as sweep gaps.
+static void gc_retire_all_tlabs(void) {
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        t->tlab_cur = NULL;
+        t->tlab_end = NULL;
+        t->tlab_region = NULL;
+        t->tlab_young = -1;
+        gc_thread_flush_counters(t);
+    }
+}
+
+// Forget the young memory and the remembered set once it has been swept
+static void gc_young_reset(void) {
+    gc_state.young_count = 0;
+    gc_state.young_overflow = 0;
+    gc_state.young_bytes = 0;
+    gc_state.remset_count = 0;
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        t->barrier_count = 0;
+    }
 }
 
 // Main garbage collection routine
 static void gc_collect(void) {
     if (!gc_state.initialized) {
-        GC_LOG("GC not initialized, skipping collection");
+        GC_LOG_DEBUG("GC not initialized, skipping collection");
         return;
     }
     
-    GC_LOG("===== GARBAGE COLLECTION STARTED (collection #%d) =====", 
+    GC_LOG_INFO("===== GARBAGE COLLECTION STARTED (collection #%d) =====", 
            gc_state.collection_count + 1);
     
-    size_t heap_used_before = gc_state.heap_used;
+    // Every thread is now outside the allocation fast path, so retiring
+    // the buffers is safe.
+    gc_stop_world();
+    gc_retire_all_tlabs();
     
-    // Count objects before collection
-    int objects_before = 0;
-    for (gc_object_t* obj = gc_state.objects; obj; obj = obj->next) {
-        objects_before++;
+    // Marks from the previous cycle must be gone before marking again. An
+    // incremental cycle in progress keeps its marks and is finished here.
+    // Generational marks are sticky (old objects stay marked), so a full
+    // collection clears them.
+    int finishing = gc_state.marking;
+    int pinned = !finishing || gc_state.pinning;           // Marks so far pinned as they went
+    if (finishing) {
+        gc_absorb_barriers();
+        if (gc_state.barrier_overflow) {
+            GC_LOG_WARN("Write barrier buffer overflowed, remarking from scratch");
+            gc_clear_marks();
+            pinned = 1;
+        }
+        __atomic_store_n(&gc_state.marking, 0, __ATOMIC_RELEASE);
+    } else {
+        gc_sweep_finish();
+        if (gc_state.generational) {
+            gc_clear_marks();
+        }
     }
+    gc_young_reset();
+    gc_state.barrier_overflow = 0;
     
-    GC_LOG("Pre-collection state: %d objects, %zu bytes used", 
+    size_t heap_used_before = gc_state.heap_used;
+    int objects_before = gc_state.object_count;
+    GC_TRACE(GC_EVENT_COLLECT_BEGIN, gc_state.collection_count + 1, heap_used_before);
+    
+    GC_LOG_DEBUG("Pre-collection state: %d objects, %zu bytes used", 
            objects_before, heap_used_before);
     
-    // Mark phase
-    GC_LOG("----- MARK PHASE -----");
+    // Mark phase. A fragmented heap is compacted this time, so marking also
+    // pins what ambiguous words point at, including what finalization
+    // revives. An incremental cycle that did not pin from the start cannot
+    // compact.
+    int compacting = gc_state.config.compact && pinned &&
+                     gc_state.fragmentation >= GC_COMPACT_FRAGMENTATION;
+    GC_LOG_DEBUG("----- MARK PHASE%s -----", finishing ? " (FINAL)" : "");
+    uint64_t phase_ns = gc_now_ns();
+    gc_state.pinning = compacting;
     gc_mark_roots();
+    gc_process_finalization();
+    gc_state.pinning = 0;
+    gc_record_phase(GC_PHASE_MARK, phase_ns);
     
-    // Count marked objects
-    int marked_objects = 0;
-    for (gc_object_t* obj = gc_state.objects; obj; obj = obj->next) {
-        if (obj->marked) marked_objects++;
+    GC_LOG_DEBUG("Mark phase complete: %d objects marked as reachable", gc_state.marked_count);
+    GC_TRACE(GC_EVENT_MARK_END, gc_state.marked_count, gc_state.marked_bytes);
+
+    if (compacting) {
+        GC_LOG_DEBUG("----- COMPACTION (fragmentation %.1f%%) -----", gc_state.fragmentation * 100);
+        gc_compact();
     }
-    GC_LOG("Mark phase complete: %d objects marked as reachable", marked_objects);
     
-    // Sweep phase
-    GC_LOG("----- SWEEP PHASE -----");
-    gc_sweep();
-    
-    // Count objects after collection
-    int objects_after = 0;
-    for (gc_object_t* obj = gc_state.objects; obj; obj = obj->next) {
-        objects_after++;
+    // Sweep phase. A lazy sweep only resets the free lists here; what was
+    // just marked is exactly what a full sweep would keep.
+    if (gc_state.config.lazy_sweep) {
+        GC_LOG_DEBUG("----- LAZY SWEEP DEFERRED -----");
+        phase_ns = gc_now_ns();
+        gc_sweep_begin();
+        gc_state.heap_used = gc_state.marked_bytes;
+        gc_state.object_count = gc_state.marked_count;
+        gc_record_phase(GC_PHASE_SWEEP, phase_ns);
+    } else {
+        GC_LOG_DEBUG("----- SWEEP PHASE -----");
+        gc_sweep();
     }
+    gc_state.marked_count = 0;
+    gc_state.marked_bytes = 0;
+    gc_update_pace();
+    gc_resize_heap();
+    
+    int objects_after = gc_state.object_count;
     
     size_t heap_used_after = gc_state.heap_used;
     size_t bytes_freed = heap_used_before - heap_used_after;
     
     gc_state.collection_count++;
+    gc_state.epoch_start_ns = gc_now_ns();
+    gc_state.epoch_start_bytes = gc_state.allocated_bytes;
+    gc_start_world();
     
-    GC_LOG("Post-collection state: %d objects, %zu bytes used", 
+    GC_LOG_DEBUG("Post-collection state: %d objects, %zu bytes used", 
            objects_after, heap_used_after);
-    GC_LOG("Collection results: %zu bytes freed, %d objects collected", 
+    GC_LOG_INFO("Collection results: %zu bytes freed, %d objects collected", 
            bytes_freed, objects_before - objects_after);
-    GC_LOG("===== GARBAGE COLLECTION COMPLETE =====");
+    GC_LOG_INFO("===== GARBAGE COLLECTION COMPLETE =====");
+    GC_TRACE(GC_EVENT_COLLECT_END, heap_used_after, gc_state.heap_size);
 }
 
-// Custom allocator that replaces malloc
-void* gc_malloc(size_t size) {
+// Record young memory handed out by the allocator. Returns its index, or -1
+// when the list cannot grow; the next minor collection then becomes a full
+// one, since it could not find every young object.
+static int gc_young_record(char* start, char* end) {
+    if (gc_state.young_count == gc_state.young_capacity &&
+        !gc_sys_grow((void**)&gc_state.young, &gc_state.young_capacity,
+                     sizeof(gc_young_range_t), 1024)) {
+        GC_LOG_WARN("Failed to grow the young list");
+        gc_state.young_overflow = 1;
+        return -1;
+    }
+    gc_young_range_t* range = &gc_state.young[gc_state.young_count];
+    range->start = start;
+    range->end = end;
+    return (int)gc_state.young_count++;
+}
+
+// Free the unmarked objects of one young range. Runs of adjacent dead
+// objects go back as one block. Marked objects are the survivors and stay
+// marked, which makes them old.
+static void gc_sweep_young_range(const gc_young_range_t* range, gc_sweep_totals_t* totals) {
+    gc_region_t* region = gc_region_of(range->start);
+    if (!region) return;
+
+    size_t first = (size_t)(range->start - region->start) / GC_ALIGNMENT;
+    size_t last = (size_t)(range->end - region->start) / GC_ALIGNMENT;
+    char* run_start = NULL;
+    char* run_end = NULL;
+
+    for (size_t w = first / GC_BITMAP_WORD_BITS; w * GC_BITMAP_WORD_BITS < last; w++) {
+        uint64_t bits = region->start_bitmap[w];
+        if (w == first / GC_BITMAP_WORD_BITS) {
+            bits &= ~(uint64_t)0 << (first % GC_BITMAP_WORD_BITS);
+        }
+        while (bits) {
+            size_t g = w * GC_BITMAP_WORD_BITS + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (g >= last) break;
+
+            gc_object_t* obj = (gc_object_t*)(region->start + g * GC_ALIGNMENT);
+            size_t total_size = sizeof(gc_object_t) + obj->size;
+            if (obj->marked) {
+                totals->objects_kept++;
+                gc_state.promoted_bytes += total_size;
+                continue;
+            }
+
+            region->start_bitmap[w] &= ~((uint64_t)1 << (g % GC_BITMAP_WORD_BITS));
+            totals->objects_swept++;
+            totals->bytes_freed += total_size;
+            if ((char*)obj != run_end) {
+                if (run_start) gc_release_block(run_start, (size_t)(run_end - run_start));
+                run_start = (char*)obj;
+            }
+            run_end = (char*)obj + total_size;
+        }
+    }
+    if (run_start) gc_release_block(run_start, (size_t)(run_end - run_start));
+}
+
+// Minor collection: mark from the roots and the remembered set, stopping at
+// old objects (already marked), then sweep only what was allocated since
+// the last collection. The cost follows the survivors, not the heap.
+// Caller holds gc_state.lock.
+static void gc_collect_minor(void) {
+    if (!gc_state.generational || gc_state.marking) {
+        gc_collect();
+        return;
+    }
+
+    uint64_t start_ns = gc_now_ns();
+    GC_LOG_INFO("===== MINOR COLLECTION STARTED (%zu young bytes) =====", gc_state.young_bytes);
+
+    // Retiring properly clips each TLAB's young range to what was used
+    gc_stop_world();
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        gc_tlab_retire(t);
+    }
+
+    if (gc_state.young_overflow || gc_state.barrier_overflow) {
+        GC_LOG_WARN("Young list or remembered set overflowed, collecting the whole heap");
+        gc_start_world();
+        gc_collect();
+        return;
+    }
+
+    // Dead objects in regions a lazy sweep has not reached yet are still
+    // unmarked with their start bits set; marking one would make it old
+    gc_sweep_finish();
+
+    GC_TRACE(GC_EVENT_COLLECT_BEGIN, gc_state.collection_count + 1, gc_state.heap_used);
+
+    uint64_t phase_ns = gc_now_ns();
+    gc_scan_roots();
+    gc_absorb_barriers();                                  // Old-to-young slots
+    gc_mark_drain();
+    gc_process_finalization();
+    gc_record_phase(GC_PHASE_MARK, phase_ns);
+
+    phase_ns = gc_now_ns();
+    gc_sweep_totals_t totals = {0, 0, 0};
+    for (size_t i = 0; i < gc_state.young_count; i++) {
+        gc_sweep_young_range(&gc_state.young[i], &totals);
+    }
+    gc_record_phase(GC_PHASE_SWEEP, phase_ns);
+    gc_state.heap_used -= totals.bytes_freed;
+    gc_state.object_count -= totals.objects_swept;
+    gc_state.marked_count = 0;
+    gc_state.marked_bytes = 0;
+    gc_young_reset();
+    gc_release_empty_regions();
+
+    gc_state.minor_count++;
+    gc_state.minor_freed_bytes += totals.bytes_freed;
+    gc_state.epoch_start_ns = gc_now_ns();
+    gc_state.epoch_start_bytes = gc_state.allocated_bytes;
+    uint64_t elapsed = gc_now_ns() - start_ns;
+    gc_state.minor_ns += elapsed;
+    if (elapsed > gc_state.minor_max_ns) gc_state.minor_max_ns = elapsed;
+    gc_start_world();
+
+    GC_LOG_INFO("Minor collection: %d objects promoted, %d collected (%zu bytes) in %.3f ms",
+           totals.objects_kept, totals.objects_swept, totals.bytes_freed, elapsed / 1e6);
+    GC_TRACE(GC_EVENT_COLLECT_END, gc_state.heap_used, gc_state.heap_size);
+}
+
+// Run a minor collection once the nursery has been handed out, or when the
+// heap is about to reach the full collection trigger; the full one only runs
+// if the minor did not free enough. Not during an incremental cycle: new
+// objects are black then, and the cycle's end forgets the young memory.
+static void gc_nursery_check(size_t size) {
+    if (!gc_state.generational || gc_state.marking || !gc_state.young_bytes) {
+        return;
+    }
+    if (gc_state.young_bytes + size > gc_state.config.nursery_size ||
+        gc_past_trigger(size)) {
+        gc_collect_minor();
+    }
+}
+
+// Allocation slow path. Caller holds gc_state.lock.
+static void* gc_malloc_locked(size_t size, int kind) {
     if (!gc_state.initialized) {
-        GC_LOG("GC not initialized, initializing now");
+        GC_LOG_DEBUG("GC not initialized, initializing now");
         gc_init();
     }
     
-    GC_LOG("Allocation request: %zu bytes", size);
+    GC_LOG_TRACE("Allocation request: %zu bytes", size);
     
     // Align size to pointer boundary
     size_t aligned_size = (size + GC_ALIGNMENT - 1) & ~(GC_ALIGNMENT - 1);
     if (aligned_size != size) {
-        GC_LOG("Size aligned from %zu to %zu", size, aligned_size);
+        GC_LOG_TRACE("Size aligned from %zu to %zu", size, aligned_size);
     }
     size = aligned_size;
     
     size_t total_size = sizeof(gc_object_t) + size;
+    if (total_size <= GC_SIZE_CLASS_MAX) {
+        total_size = gc_size_class_size(gc_size_class_for(total_size));
+    }
     
-    GC_LOG("Total allocation size (with header): %zu bytes", total_size);
+    GC_LOG_TRACE("Total allocation size (with header): %zu bytes", total_size);
     
     // Check if we need to collect garbage
-    double heap_usage = (double)gc_state.heap_used / gc_state.heap_size;
-    if (gc_state.heap_used + total_size > gc_state.heap_size * GC_THRESHOLD) {
-        GC_LOG("Heap usage %.1f%% exceeds threshold %.1f%%, triggering collection", 
-               heap_usage * 100, GC_THRESHOLD * 100);
+    gc_nursery_check(total_size);
+    if (gc_past_trigger(total_size)) {
+        GC_LOG_DEBUG("Heap usage %zu bytes reaches trigger %zu bytes, triggering collection", 
+               gc_state.heap_used + total_size, gc_state.next_trigger);
         gc_collect();
     }
     
     // Try to allocate from free list
-    void* ptr = gc_alloc_from_freelist(total_size);
+    size_t block_size = 0;
+    void* ptr = gc_alloc_or_sweep(total_size, &block_size);
     
     if (!ptr) {
-        GC_LOG("No suitable free block found, trying collection");
-        // No suitable free block found
-        gc_collect(); // Try collecting again
-        ptr = gc_alloc_from_freelist(total_size);
+        // Free blocks only coalesce on a miss, which is far cheaper than a
+        // collection.
+        gc_coalesce_free_blocks();
+        ptr = gc_alloc_from_freelist(total_size, &block_size);
+    }
+    
+    if (!ptr) {
+        // Below the trigger the pacer has budgeted this memory, so the heap
+        // grows first and only collects if it cannot.
+        int collected = 0;
+        if (gc_past_trigger(total_size)) {
+            GC_LOG_DEBUG("No suitable free block found, trying collection");
+            gc_collect();
+            collected = 1;
+            ptr = gc_alloc_or_sweep(total_size, &block_size);
+            
+            if (!ptr) {
+                gc_coalesce_free_blocks();
+                ptr = gc_alloc_from_freelist(total_size, &block_size);
+            }
+        }
+        
+        if (!ptr) {
+            // Map a region big enough for this request (at least one
+            // regular region).
+            size_t region_size = total_size + GC_ALIGNMENT;
+            if (region_size < gc_state.config.region_size) {
+                region_size = gc_state.config.region_size;
+            }
+            GC_LOG_INFO("Growing heap by %zu bytes", region_size);
+            if (gc_add_region(region_size)) {
+                ptr = gc_alloc_from_freelist(total_size, &block_size);
+            }
+        }
+        
+        if (!ptr && !collected) {
+            GC_LOG_DEBUG("Heap cannot grow, trying collection");
+            gc_collect();
+            ptr = gc_alloc_or_sweep(total_size, &block_size);
+            if (!ptr) {
+                gc_coalesce_free_blocks();
+                ptr = gc_alloc_from_freelist(total_size, &block_size);
+            }
+        }
         
         if (!ptr) {
-            GC_LOG("Still no memory after collection - OUT OF MEMORY");
+            GC_LOG_WARN("Still no memory after collection - OUT OF MEMORY");
             fprintf(stderr, "GC: Out of memory\n");
             return NULL;
         }
@@ -541,32 +3153,287 @@ void* gc_malloc(size_t size) {
     
     // Initialize object header
     gc_object_t* obj = (gc_object_t*)ptr;
+    size = block_size - sizeof(gc_object_t);
     obj->size = size;
-    obj->marked = 0;
-    obj->next = gc_state.objects;
-    gc_state.objects = obj;
+    obj->marked = gc_state.marking;                        // Black while marking
+    obj->flags = obj->marked && gc_state.pinning ? GC_FLAG_PINNED : 0;
+    obj->kind = kind;
+    if (obj->marked) {
+        gc_state.marked_count++;
+        gc_state.marked_bytes += block_size;
+    }
+    gc_bitmap_set(gc_region_of(obj), obj);
+    gc_state.object_count++;
+    if (block_size > gc_state.max_object_size) {
+        gc_state.max_object_size = block_size;
+    }
     
-    gc_state.heap_used += total_size;
+    if (block_size <= GC_SIZE_CLASS_MAX) {
+        gc_state.class_live_count[gc_size_class_for(block_size)]++;
+    }
+    gc_state.heap_used += block_size;
     gc_state.allocation_count++;
+    gc_state.allocated_bytes += block_size;
+    if (gc_state.generational) {
+        gc_young_record((char*)ptr, (char*)ptr + block_size);
+        gc_state.young_bytes += block_size;
+    }
     
-    // Zero the memory
-    memset(obj->data, 0, size);
+    // Zero the memory; atomic data is never scanned, so stale bytes are harmless
+    if (kind != GC_KIND_ATOMIC) {
+        memset(obj->data, 0, size);
+    }
     
-    GC_LOG("Allocation successful: %p (object #%d, user data at %p)", 
+    GC_LOG_TRACE("Allocation successful: %p (object #%d, user data at %p)", 
            obj, gc_state.allocation_count, obj->data);
+    GC_TRACE(GC_EVENT_ALLOC, obj->data, size);
     
     return obj->data;
 }
 
+// Carve a fresh allocation buffer for the calling thread. Caller holds
+// gc_state.lock. Returns 0 if the heap cannot spare one right now.
+static int gc_tlab_refill(gc_thread_t* self) {
+    gc_tlab_retire(self);
+
+    gc_nursery_check(GC_TLAB_SIZE);
+    if (gc_past_trigger(GC_TLAB_SIZE)) {
+        GC_LOG_DEBUG("TLAB refill would reach the trigger, triggering collection");
+        gc_collect();
+    }
+
+    size_t block_size = 0;
+    char* chunk = gc_alloc_or_sweep(GC_TLAB_SIZE, &block_size);
+    if (!chunk) return 0;
+
+    self->tlab_cur = chunk;
+    self->tlab_end = chunk + block_size;
+    self->tlab_region = gc_region_of(chunk);
+    gc_state.heap_used += block_size;
+    if (gc_state.generational) {
+        self->tlab_young = gc_young_record(chunk, chunk + block_size);
+        gc_state.young_bytes += block_size;
+    }
+    GC_LOG_TRACE("TLAB refill: %p, %zu bytes", chunk, block_size);
+    return 1;
+}
+
+// Bump-allocate from the calling thread's buffer without taking the lock.
+// A suspend signal that lands in here is deferred until the object is fully
+// published (header written, start bit set, cursor bumped).
+static inline void* gc_tlab_alloc(gc_thread_t* self, size_t total_size, int kind) {
+    void* result = NULL;
+
+    self->in_alloc = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    char* cur = self->tlab_cur;
+    if ((size_t)(self->tlab_end - cur) >= total_size) {
+        gc_object_t* obj = (gc_object_t*)cur;
+        obj->size = total_size - sizeof(gc_object_t);
+        obj->marked = gc_state.marking;                    // Black while marking
+        obj->flags = obj->marked && gc_state.pinning ? GC_FLAG_PINNED : 0;
+        obj->kind = kind;
+        if (obj->marked) {
+            self->black_count++;
+            self->black_bytes += total_size;
+        }
+        if (kind != GC_KIND_ATOMIC) {
+            memset(obj->data, 0, obj->size);
+        }
+        gc_bitmap_set(self->tlab_region, obj);
+        self->tlab_cur = cur + total_size;
+        self->allocation_count++;
+        self->object_count++;
+        self->allocated_bytes += total_size;
+        self->class_live_count[gc_size_class_for(total_size)]++;
+        result = obj->data;
+    }
+
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    self->in_alloc = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (self->suspend_pending) {
+        self->suspend_pending = 0;
+        gc_suspend_self(self);
+    }
+    if (result) {
+        GC_TRACE(GC_EVENT_ALLOC, result, total_size - sizeof(gc_object_t));
+    }
+    return result;
+}
+
+// Take `extra` bytes from the free block that starts at `addr`, if there is
+// one. O(1): the free bitmap says whether a listed block starts there, and
+// it unlinks from its bucket or bin directly. Free bits of a
+// region that is still being swept are only current below sweep_word.
+// Returns the bytes taken (a little more when the rest would be too small
+// to reuse), or 0. Caller holds gc_state.lock.
+static size_t gc_take_adjacent(gc_region_t* region, char* addr, size_t extra) {
+    if (addr >= region->start + region->size) return 0;
+    if (region->needs_sweep &&
+        gc_granule_of(region, addr) >= region->sweep_word * GC_BITMAP_WORD_BITS) {
+        return 0;
+    }
+    if (!gc_free_bit(region, addr)) return 0;
+
+    gc_free_block_t* block = (gc_free_block_t*)addr;
+    if (block->size < extra) return 0;
+
+    size_t remainder = block->size - extra;
+    gc_take_free_block(block);
+    if (remainder < sizeof(gc_object_t) + GC_ALIGNMENT) {
+        return block->size;
+    }
+    gc_release_block(addr + extra, remainder);
+    return extra;
+}
+
+// Grow an object by at least `extra` bytes without moving it: bump the
+// caller's buffer if the object is the last one carved from it, otherwise
+// eat into a free block right behind it. Returns 0 if neither works.
+// Caller holds gc_state.lock.
+static int gc_grow_in_place(gc_thread_t* self, gc_object_t* obj, size_t extra) {
+    char* end = obj->data + obj->size;
+    size_t taken = 0;
+
+    if (self && end == self->tlab_cur && (size_t)(self->tlab_end - end) >= extra &&
+        sizeof(gc_object_t) + obj->size + extra <= GC_SIZE_CLASS_MAX) {
+        self->tlab_cur += extra;                           // Already counted as used
+        taken = extra;
+    } else {
+        taken = gc_take_adjacent(gc_region_of(obj), end, extra);
+        if (!taken) return 0;
+        gc_state.heap_used += taken;
+    }
+
+    memset(end, 0, taken);
+    obj->size += taken;
+    if (sizeof(gc_object_t) + obj->size > gc_state.max_object_size) {
+        gc_state.max_object_size = sizeof(gc_object_t) + obj->size;
+    }
+    if (gc_state.marking && obj->marked) {
+        gc_state.marked_bytes += taken;
+    }
+    GC_LOG_TRACE("Grew %p in place by %zu bytes", obj->data, taken);
+    return 1;
+}
+
+// Run what the last collection queued, unless the application does that
+// itself. Called on the slow paths once the lock is released; a finalizer
+// that allocates does not recurse into the queue.
+static inline void gc_finalize_queued(void) {
+    if (__atomic_load_n(&gc_state.finalize_queue_count, __ATOMIC_RELAXED) &&
+        !gc_state.config.finalize_on_demand && !gc_finalizing) {
+        gc_run_finalizers();
+    }
+}
+
+// Allocate an object of the given kind: the TLAB when it is small, the
+// locked slow path otherwise
+static void* gc_malloc_kind(size_t size, int kind) {
+    gc_thread_t* self = gc_self;
+    if (!self) {
+        gc_register_thread();
+        self = gc_self;
+    }
+
+    // Small requests take the block size of their class, as on the slow
+    // path, so TLAB and free-list objects share one size-class geometry
+    size_t total_size = sizeof(gc_object_t) + ((size + GC_ALIGNMENT - 1) & ~(GC_ALIGNMENT - 1));
+    if (self && total_size <= GC_SIZE_CLASS_MAX) {
+        total_size = gc_size_class_size(gc_size_class_for(total_size));
+        void* ptr = gc_tlab_alloc(self, total_size, kind);
+        if (ptr) return ptr;
+
+        pthread_mutex_lock(&gc_state.lock);
+        int refilled = gc_tlab_refill(self);
+        pthread_mutex_unlock(&gc_state.lock);
+
+        if (refilled && (ptr = gc_tlab_alloc(self, total_size, kind))) {
+            gc_finalize_queued();
+            return ptr;
+        }
+    }
+
+    pthread_mutex_lock(&gc_state.lock);
+    void* ptr = gc_malloc_locked(size, kind);
+    pthread_mutex_unlock(&gc_state.lock);
+    gc_finalize_queued();
+    return ptr;
+}
+
+// Custom allocator that replaces malloc
+void* gc_malloc(size_t size) {
+    return gc_malloc_kind(size, GC_KIND_CONSERVATIVE);
+}
+
+// Allocate memory that will never hold GC pointers: strings, pixel and
+// numeric buffers. It is never scanned, so it cannot keep other objects
+// alive by accident, and it is not zeroed.
+void* gc_malloc_atomic(size_t size) {
+    return gc_malloc_kind(size, GC_KIND_ATOMIC);
+}
+
+// Describe a struct for gc_malloc_typed: `offsets` are the byte offsets of
+// its `count` pointer fields, `size` its size. Returns a layout id, or -1
+// if the layout cannot be recorded.
+int gc_register_layout(size_t size, const size_t* offsets, size_t count) {
+    if (!gc_state.initialized) gc_init();
+
+    size_t words = (size + sizeof(void*) - 1) / sizeof(void*);
+    if (words == 0) words = 1;
+    size_t bitmap_words = (words + 63) / 64;
+    uint64_t* bits = gc_sys_alloc(bitmap_words * sizeof(uint64_t));
+    if (!bits) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (offsets[i] % sizeof(void*) || offsets[i] >= words * sizeof(void*)) {
+            GC_LOG_WARN("Layout pointer offset %zu is misaligned or out of range", offsets[i]);
+            munmap(bits, bitmap_words * sizeof(uint64_t));
+            return -1;
+        }
+        size_t w = offsets[i] / sizeof(void*);
+        bits[w / 64] |= (uint64_t)1 << (w % 64);
+    }
+
+    pthread_mutex_lock(&gc_state.lock);
+    int id = -1;
+    if (gc_state.layout_count < GC_LAYOUT_MAX &&
+        (gc_state.layout_count < gc_state.layout_capacity ||
+         gc_sys_grow((void**)&gc_state.layouts, &gc_state.layout_capacity, sizeof(gc_layout_t), 16))) {
+        id = (int)gc_state.layout_count++;
+        gc_state.layouts[id].words = words;
+        gc_state.layouts[id].bits = bits;
+    }
+    pthread_mutex_unlock(&gc_state.lock);
+
+    if (id < 0) {
+        GC_LOG_WARN("Failed to register a layout of %zu bytes", size);
+        munmap(bits, bitmap_words * sizeof(uint64_t));
+    }
+    return id;
+}
+
+// Allocate an object laid out as registered with gc_register_layout; only
+// its pointer fields are scanned. A size larger than the layout makes an
+// array of it. An unknown layout falls back to conservative scanning.
+void* gc_malloc_typed(size_t size, int layout) {
+    if (layout < 0 || (size_t)layout >= gc_state.layout_count) {
+        GC_LOG_WARN("Unknown layout %d, allocating a conservative object", layout);
+        return gc_malloc(size);
+    }
+    return gc_malloc_kind(size, GC_KIND_TYPED + layout);
+}
+
 // Replacement for calloc
 void* gc_calloc(size_t num, size_t size) {
-    GC_LOG("Calloc request: %zu items of %zu bytes each", num, size);
+    GC_LOG_TRACE("Calloc request: %zu items of %zu bytes each", num, size);
     return gc_malloc(num * size);  // gc_malloc already zeros memory
 }
 
 // Replacement for realloc
 void* gc_realloc(void* ptr, size_t new_size) {
-    GC_LOG("Realloc request: %p to %zu bytes", ptr, new_size);
+    GC_LOG_TRACE("Realloc request: %p to %zu bytes", ptr, new_size);
     
     if (!ptr) {
         return gc_malloc(new_size);
@@ -577,36 +3444,56 @@ void* gc_realloc(void* ptr, size_t new_size) {
         return NULL;
     }
 
-    // Find the object header for the given pointer.
-    gc_object_t* obj = NULL;
-    for (gc_object_t* curr = gc_state.objects; curr; curr = curr->next) {
-        if (curr->data == ptr) {
-            obj = curr;
-            break;
-        }
+    gc_thread_t* self = gc_self;
+    if (!self) {
+        gc_register_thread();
+        self = gc_self;
     }
+    size_t aligned_new_size = (new_size + GC_ALIGNMENT - 1) & ~(GC_ALIGNMENT - 1);
+
+    // The header sits right before the data; the lock keeps the region
+    // table stable while it is checked.
+    pthread_mutex_lock(&gc_state.lock);
+    gc_object_t* obj = gc_object_of(ptr);
+    size_t old_size = obj ? obj->size : 0;
+    int kind = obj ? obj->kind : GC_KIND_CONSERVATIVE;
+    int in_place = obj && (aligned_new_size <= old_size ||
+                           gc_grow_in_place(self, obj, aligned_new_size - old_size));
+    pthread_mutex_unlock(&gc_state.lock);
 
     if (!obj) {
-        GC_LOG("Warning: realloc called on non-GC pointer or stale pointer.");
+        GC_LOG_WARN("realloc called on non-GC pointer or stale pointer.");
         return gc_malloc(new_size); // Fallback to malloc
     }
 
-    size_t aligned_new_size = (new_size + GC_ALIGNMENT - 1) & ~(GC_ALIGNMENT - 1);
-
-    // If the new size fits in the old block, just return the same pointer.
-    if (aligned_new_size <= obj->size) {
-        GC_LOG("Shrinking in place. Old size: %zu, New size: %zu", obj->size, aligned_new_size);
+    // If the new size fits in the old block, or the block grew, just
+    // return the same pointer.
+    if (in_place) {
+        GC_LOG_TRACE("Resized in place. Old size: %zu, New size: %zu", old_size, aligned_new_size);
         return ptr;
+    }
 
     // --- FALLBACK: Allocate new block and copy ---
-    GC_LOG("Fallback: allocating new block and copying data.");
-    void* new_ptr = gc_malloc(new_size);
+    // Leave headroom so the next growth steps fit in the new block.
+    GC_LOG_TRACE("Fallback: allocating new block and copying data.");
+    size_t grown_size = (size_t)(old_size * GC_REALLOC_GROWTH);
+    void* new_ptr = gc_malloc_kind(new_size > grown_size ? new_size : grown_size, kind);
     if (!new_ptr) {
         return NULL; // Out of memory
     }
     
     // Copy data from the old block to the new one.
-    memcpy(new_ptr, ptr, obj->size); // Copy up to the old size.
+    memcpy(new_ptr, ptr, old_size); // Copy up to the old size.
+
+    // A copy made while marking is black but holds pointers that were never
+    // seen through the barrier; queue it for scanning.
+    if (gc_state.marking) {
+        pthread_mutex_lock(&gc_state.lock);
+        if (gc_state.marking) {
+            gc_mark_push((gc_object_t*)((char*)new_ptr - sizeof(gc_object_t)));
+        }
+        pthread_mutex_unlock(&gc_state.lock);
+    }
 
     // The old object (ptr) is now garbage and will be collected on the next cycle.
     return new_ptr;
@@ -614,38 +3501,547 @@ void* gc_realloc(void* ptr, size_t new_size) {
 
 // No-op free
 void gc_free(void* ptr) {
-    GC_LOG("Free called on %p (no-op - GC handles deallocation)", ptr);
+    GC_LOG_TRACE("Free called on %p (no-op - GC handles deallocation)", ptr);
 }
 
 // Manual GC trigger (optional)
 void gc_force_collect(void) {
-    GC_LOG("Force collection requested");
+    GC_LOG_DEBUG("Force collection requested");
+    gc_register_thread();
+    pthread_mutex_lock(&gc_state.lock);
     gc_collect();
+    pthread_mutex_unlock(&gc_state.lock);
+    gc_finalize_queued();
+}
+
+// Call fn(obj, data) once obj has become unreachable. obj must be the start
+// of a GC object; registering it again replaces its finalizer and a NULL fn
+// removes it. obj stays valid until the finalizer returns and is freed by
+// a later collection unless the finalizer stored it somewhere reachable.
+// data is passed through untouched and is not traced. Objects that die
+// together are finalized in no particular order, and a finalizer does not
+// follow an object that gc_realloc moves. Returns 0 if obj is not a GC
+// object or the table cannot grow.
+int gc_register_finalizer(void* obj, gc_finalizer_fn fn, void* data) {
+    if (!gc_state.initialized) gc_init();
+    gc_register_thread();
+
+    pthread_mutex_lock(&gc_state.lock);
+    gc_object_t* header = obj ? gc_object_of(obj) : NULL;
+    if (!header) {
+        pthread_mutex_unlock(&gc_state.lock);
+        GC_LOG_WARN("Finalizer for %p ignored: not a GC object", obj);
+        return 0;
+    }
+
+    if (header->flags & GC_FLAG_FINALIZER) {
+        for (size_t i = 0; i < gc_state.finalizer_count; i++) {
+            gc_finalizer_t* entry = &gc_state.finalizers[i];
+            if (entry->obj != obj) continue;
+            if (fn) {
+                entry->fn = fn;
+                entry->data = data;
+            } else {
+                *entry = gc_state.finalizers[--gc_state.finalizer_count];
+                header->flags &= ~GC_FLAG_FINALIZER;
+            }
+            break;
+        }
+        pthread_mutex_unlock(&gc_state.lock);
+        return 1;
+    }
+    if (!fn) {
+        pthread_mutex_unlock(&gc_state.lock);
+        return 1;
+    }
+
+    if (gc_state.finalizer_count == gc_state.finalizer_capacity &&
+        !gc_sys_grow((void**)&gc_state.finalizers, &gc_state.finalizer_capacity,
+                     sizeof(gc_finalizer_t), 64)) {
+        pthread_mutex_unlock(&gc_state.lock);
+        GC_LOG_WARN("Failed to grow the finalizer table");
+        return 0;
+    }
+    gc_finalizer_t* entry = &gc_state.finalizers[gc_state.finalizer_count++];
+    entry->obj = obj;
+    entry->fn = fn;
+    entry->data = data;
+    header->flags |= GC_FLAG_FINALIZER;
+    pthread_mutex_unlock(&gc_state.lock);
+    return 1;
+}
+
+// Run every queued finalizer on the calling thread, without the lock held,
+// so finalizers may allocate and collect. Returns how many ran. With
+// finalize_on_demand this is the only place finalizers run.
+int gc_run_finalizers(void) {
+    if (!gc_state.initialized || gc_finalizing) return 0;
+    gc_register_thread();
+
+    gc_finalizing = 1;
+    int run = 0;
+    for (;;) {
+        pthread_mutex_lock(&gc_state.lock);
+        if (!gc_state.finalize_queue_count) {
+            pthread_mutex_unlock(&gc_state.lock);
+            break;
+        }
+        // Off the queue, the object is kept alive through the thread record
+        gc_finalizer_t entry = gc_state.finalize_queue[--gc_state.finalize_queue_count];
+        gc_state.finalizers_run++;
+        gc_self->finalizing = entry.obj;
+        pthread_mutex_unlock(&gc_state.lock);
+
+        entry.fn(entry.obj, entry.data);
+        gc_self->finalizing = NULL;
+        run++;
+    }
+    gc_finalizing = 0;
+    return run;
+}
+
+// Weak reference to target: gc_weak_get returns target while the object
+// holding it is alive, and NULL once a collection has found that object
+// unreachable. The reference is a GC object itself and is collected like
+// any other. Returns NULL when out of memory.
+gc_weak_t* gc_weak_new(void* target) {
+    gc_register_thread();
+
+    // Allocated under the lock, so no collection can run before the
+    // reference is in the table
+    pthread_mutex_lock(&gc_state.lock);
+    if (gc_state.weak_count == gc_state.weak_capacity &&
+        !gc_sys_grow((void**)&gc_state.weak_refs, &gc_state.weak_capacity,
+                     sizeof(gc_weak_t*), 64)) {
+        pthread_mutex_unlock(&gc_state.lock);
+        GC_LOG_WARN("Failed to grow the weak reference table");
+        return NULL;
+    }
+    gc_weak_t* weak = gc_malloc_locked(sizeof(gc_weak_t), GC_KIND_ATOMIC);
+    if (weak) {
+        weak->target = target;
+        gc_state.weak_refs[gc_state.weak_count++] = weak;
+    }
+    pthread_mutex_unlock(&gc_state.lock);
+    return weak;
+}
+
+// Target of a weak reference, or NULL once it has been collected. The
+// result is an ordinary strong pointer for as long as the caller holds it.
+void* gc_weak_get(const gc_weak_t* weak) {
+    return weak ? *(void* const volatile*)&weak->target : NULL;
+}
+
+// Register [start, end) as a root. Caller holds gc_state.lock.
+static int gc_add_root_locked(void* start, void* end, int precise) {
+    if (gc_state.root_count == gc_state.root_capacity &&
+        !gc_sys_grow((void**)&gc_state.roots, &gc_state.root_capacity,
+                     sizeof(gc_root_range_t), 64)) {
+        GC_LOG_WARN("Failed to grow the root table");
+        return 0;
+    }
+    gc_root_range_t* root = &gc_state.roots[gc_state.root_count++];
+    root->start = start;
+    root->end = end;
+    root->precise = precise;
+    return 1;
+}
+
+// Drop the root registered as exactly [start, end)
+static void gc_remove_root_locked(void* start, void* end) {
+    for (size_t i = 0; i < gc_state.root_count; i++) {
+        gc_root_range_t* root = &gc_state.roots[i];
+        if (root->start == (char*)start && root->end == (char*)end) {
+            *root = gc_state.roots[--gc_state.root_count];
+            return;
+        }
+    }
+}
+
+// Treat *addr as a root, e.g. a global holding a GC pointer. The slot is
+// taken to hold a pointer or NULL, so compaction may move its target and
+// rewrite the slot. Returns 0 if the table cannot grow.
+int gc_add_root(void** addr) {
+    if (!gc_state.initialized) gc_init();
+    pthread_mutex_lock(&gc_state.lock);
+    int added = gc_add_root_locked(addr, addr + 1, 1);
+    pthread_mutex_unlock(&gc_state.lock);
+    return added;
+}
+
+// Scan [start, end) conservatively at every collection, like a stack:
+// static data, or memory from the system allocator holding GC pointers.
+// Returns 0 if the table cannot grow.
+int gc_add_root_range(void* start, void* end) {
+    if (!gc_state.initialized) gc_init();
+    pthread_mutex_lock(&gc_state.lock);
+    int added = gc_add_root_locked(start, end, 0);
+    pthread_mutex_unlock(&gc_state.lock);
+    return added;
+}
+
+void gc_remove_root(void** addr) {
+    if (!gc_state.initialized) return;
+    pthread_mutex_lock(&gc_state.lock);
+    gc_remove_root_locked(addr, addr + 1);
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+void gc_remove_root_range(void* start, void* end) {
+    if (!gc_state.initialized) return;
+    pthread_mutex_lock(&gc_state.lock);
+    gc_remove_root_locked(start, end);
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+// Install a function that reports precise roots, such as the frames of a
+// shadow stack, at every collection; NULL removes it. It runs on the
+// collecting thread with every other thread stopped, once to mark and again
+// after compaction to let the visitor rewrite moved slots. With
+// scan_stacks off, everything the program holds across an allocation
+// must be reachable from registered roots or the scanner.
+void gc_set_root_scanner(gc_root_scanner_fn scanner, void* data) {
+    if (!gc_state.initialized) gc_init();
+    pthread_mutex_lock(&gc_state.lock);
+    gc_state.root_scanner = scanner;
+    gc_state.root_scanner_data = data;
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+// Sweep one slice of a lazy collection, e.g. from an idle loop. Returns
+// nonzero while more of the heap is still waiting to be swept.
+int gc_sweep_step(void) {
+    if (!gc_state.initialized) return 0;
+    pthread_mutex_lock(&gc_state.lock);
+    gc_sweep_slice();
+    int pending = gc_state.sweep_pending > 0;
+    pthread_mutex_unlock(&gc_state.lock);
+    return pending;
+}
+
+// Write barrier for incremental marking and generational mode, e.g.
+// GC_WRITE(node->next, other). With both off it costs two loads and a
+// branch. The check and the store are one signal-deferred section, so a
+// collection cannot start between them.
+static inline void gc_barrier_enter(gc_thread_t* self) {
+    self->in_alloc = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void gc_barrier_leave(gc_thread_t* self) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    self->in_alloc = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (self->suspend_pending) {
+        self->suspend_pending = 0;
+        gc_suspend_self(self);
+    }
+    if (self->barrier_count >= GC_BARRIER_BUFFER / 2) {
+        gc_write_barrier_flush(self);
+    }
+}
+
+static inline gc_thread_t* gc_barrier_self(void) {
+    if (!gc_self) gc_register_thread();
+    return gc_self;
+}
+
+#define GC_WRITE(lhs, value) \
+    do { \
+        __typeof__(lhs) gc_wb_value_ = (value); \
+        gc_thread_t* gc_wb_self_ = gc_barrier_self(); \
+        gc_barrier_enter(gc_wb_self_); \
+        if (gc_state.marking || gc_state.generational) \
+            gc_write_barrier_record(gc_wb_self_, (void**)&(lhs), (void*)gc_wb_value_); \
+        (lhs) = gc_wb_value_; \
+        gc_barrier_leave(gc_wb_self_); \
+    } while (0)
+
+// Do up to budget_us microseconds of collector work: lazy sweeping left by
+// the last cycle, then incremental marking once the heap is
+// GC_INCREMENTAL_START full. The cycle's last step rescans the roots and
+// sweeps. Returns nonzero while a cycle or sweep is still in progress.
+//
+// While a cycle runs, every store of a GC pointer into GC memory must go
+// through GC_WRITE; code that cannot guarantee that should not call
+// gc_step and will only see full collections.
+int gc_step(long budget_us) {
+    gc_register_thread();
+    uint64_t deadline = gc_now_ns() + (uint64_t)(budget_us > 0 ? budget_us : 0) * 1000;
+
+    pthread_mutex_lock(&gc_state.lock);
+    if (!gc_state.marking) {
+        while (gc_state.sweep_pending && gc_now_ns() < deadline) {
+            gc_sweep_slice();
+        }
+        if (gc_state.sweep_pending ||
+            gc_state.heap_used < gc_state.next_trigger * GC_INCREMENTAL_START) {
+            int pending = gc_state.sweep_pending > 0;
+            pthread_mutex_unlock(&gc_state.lock);
+            return pending;
+        }
+
+        gc_stop_world();
+        gc_mark_begin();
+        gc_start_world();
+    }
+
+    gc_stop_world();
+    int done = gc_mark_increment(deadline);
+    gc_start_world();
+    if (done) {
+        gc_collect();
+    }
+
+    int pending = gc_state.marking || gc_state.sweep_pending > 0;
+    pthread_mutex_unlock(&gc_state.lock);
+    return pending;
+}
+
+// Runtime log filter; levels above GC_LOG_LEVEL are compiled out regardless
+void gc_set_log_level(int level) {
+    gc_log_level = level;
+}
+
+// Redirect log output (NULL restores stderr)
+void gc_set_log_stream(FILE* stream) {
+    gc_log_stream = stream;
+}
+
+#if GC_TRACE_RING_SIZE > 0
+// Pause or resume event recording
+void gc_trace_enable(int enabled) {
+    gc_trace_ring.enabled = enabled;
+}
+
+// Write buffered trace events, oldest first, one per line:
+//   gc-trace <time_ns> <event> <a> <b>
+// and empty the buffer. Events still being recorded by another thread, or
+// already overwritten by a newer one, are skipped.
+void gc_trace_flush(FILE* out) {
+    static const char* const names[GC_EVENT_COUNT] = {
+        "alloc", "collect_begin", "mark_end", "sweep_end",
+        "collect_end", "region_map", "region_unmap", "mark_step"
+    };
+    if (!out) out = stderr;
+
+    uint64_t next = __atomic_load_n(&gc_trace_ring.next, __ATOMIC_ACQUIRE);
+    uint64_t first = next > GC_TRACE_RING_SIZE ? next - GC_TRACE_RING_SIZE : 0;
+    if (first < gc_trace_ring.flushed) first = gc_trace_ring.flushed;
+    for (uint64_t i = first; i < next; i++) {
+        const gc_trace_event_t* ev = &gc_trace_ring.events[i % GC_TRACE_RING_SIZE];
+        if (__atomic_load_n(&ev->seq, __ATOMIC_ACQUIRE) != i + 1) continue;
+        fprintf(out, "gc-trace %llu %s 0x%lx 0x%lx\n", (unsigned long long)ev->time_ns,
+                names[ev->type], (unsigned long)ev->a, (unsigned long)ev->b);
+    }
+    gc_trace_ring.flushed = next;
+    fflush(out);
+}
+#else
+void gc_trace_enable(int enabled) { (void)enabled; }
+void gc_trace_flush(FILE* out) { (void)out; }
+#endif
+
+// Fold in each thread's pending counters. heap_used counts an allocation
+// buffer whole from the moment it is carved, so this returns the unused
+// tails of the buffers, which are still free. The owners bump their
+// cursors without the lock; a stale one is off by the objects in flight.
+// Caller holds gc_state.lock.
+static size_t gc_flush_all_counters(void) {
+    size_t unused = 0;
+    for (gc_thread_t* t = gc_state.threads; t; t = t->next) {
+        gc_thread_flush_counters(t);
+        char* cur = __atomic_load_n(&t->tlab_cur, __ATOMIC_RELAXED);
+        if (cur && cur < t->tlab_end) {
+            unused += (size_t)(t->tlab_end - cur);
+        }
+    }
+    return unused;
+}
+
+// Take a snapshot of the collector's counters. Cheap enough to poll: it
+// only folds in each thread's pending counters.
+void gc_get_stats(struct gc_stats* stats) {
+    if (!gc_state.initialized) gc_init();
+    pthread_mutex_lock(&gc_state.lock);
+    size_t tlab_unused = gc_flush_all_counters();
+    size_t live = gc_state.heap_used > tlab_unused ? gc_state.heap_used - tlab_unused : 0;
+
+    stats->heap_size = gc_state.heap_size;
+    stats->live_bytes = live;
+    stats->live_objects = gc_state.object_count > 0 ? (size_t)gc_state.object_count : 0;
+    stats->free_bytes = gc_state.heap_size > live ? gc_state.heap_size - live : 0;
+    stats->largest_free_block = gc_state.largest_free;
+    stats->fragmentation = gc_state.fragmentation;
+    stats->collections = gc_state.collection_count;
+    stats->minor_collections = gc_state.minor_count;
+    stats->compactions = gc_state.compactions;
+    stats->allocations = gc_state.allocation_count;
+    stats->allocated_bytes = gc_state.allocated_bytes;
+
+    uint64_t elapsed = gc_now_ns() - gc_state.epoch_start_ns;
+    stats->allocation_rate = elapsed ?
+        (double)(gc_state.allocated_bytes - gc_state.epoch_start_bytes) * 1e9 / elapsed : 0.0;
+    stats->next_trigger = gc_state.next_trigger;
+    stats->gc_cpu_share = gc_state.gc_cpu_share;
+    stats->finalizers_run = gc_state.finalizers_run;
+    stats->weak_cleared = gc_state.weak_cleared;
+    stats->sweep_slices = gc_state.sweep_slices;
+    stats->sweep_slice_bytes = gc_state.sweep_slice_bytes;
+    stats->sweep_slice_freed = gc_state.sweep_slice_freed;
+    stats->sweep_pending = gc_state.sweep_pending;
+
+    memcpy(stats->pause_count, gc_state.pause_count, sizeof(stats->pause_count));
+    memcpy(stats->pause_total_ns, gc_state.pause_total_ns, sizeof(stats->pause_total_ns));
+    memcpy(stats->pause_max_ns, gc_state.pause_max_ns, sizeof(stats->pause_max_ns));
+    memcpy(stats->pause_histogram, gc_state.pause_histogram, sizeof(stats->pause_histogram));
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+// Read the current heap growth policy
+void gc_get_config(gc_config_t* config) {
+    if (!gc_state.initialized) gc_init();
+    pthread_mutex_lock(&gc_state.lock);
+    *config = gc_state.config;
+    pthread_mutex_unlock(&gc_state.lock);
+}
+
+// Change the heap growth policy. Takes effect immediately: the trigger and
+// heap target are recomputed from the current live bytes and the heap grown
+// to match.
+void gc_configure(const gc_config_t* config) {
+    if (!gc_state.initialized) gc_init();
+    gc_register_thread();
+
+    pthread_mutex_lock(&gc_state.lock);
+    gc_config_t next = *config;
+    if (next.region_size < gc_state.page_size) {
+        next.region_size = gc_state.page_size;
+    }
+    if (next.growth_factor < 1.0) {
+        next.growth_factor = 1.0;
+    }
+    if (next.mark_threads < 1) {
+        next.mark_threads = 1;
+    } else if (next.mark_threads > GC_MARK_THREADS_MAX) {
+        next.mark_threads = GC_MARK_THREADS_MAX;
+    }
+    if (next.nursery_size < GC_TLAB_SIZE) {
+        next.nursery_size = GC_TLAB_SIZE;
+    }
+    if (next.cpu_target < 0) {
+        next.cpu_target = 0;
+    }
+    gc_state.config = next;
+
+    if (!next.lazy_sweep) {
+        gc_sweep_finish();
+    }
+
+    // Turning generations on: a full collection leaves every survivor
+    // marked, i.e. old. Turning them off: clear the sticky marks so the
+    // next collection starts from white.
+    if (next.generational && !gc_state.generational) {
+        gc_state.generational = 1;
+        gc_collect();
+    } else if (!next.generational && gc_state.generational) {
+        gc_stop_world();
+        gc_retire_all_tlabs();
+        gc_state.generational = 0;
+        if (!gc_state.marking) {
+            gc_sweep_finish();
+            gc_clear_marks();
+        }
+        gc_young_reset();
+        gc_start_world();
+    }
+
+    GC_LOG_INFO("Configured: region %zu, min %zu, max %zu, growth %.2f, cpu target %.2f, %d markers, %s sweep, %s%s",
+           next.region_size, next.min_heap_size, next.max_heap_size, next.growth_factor, next.cpu_target,
+           next.mark_threads, next.lazy_sweep ? "lazy" : "eager",
+           next.generational ? "generational" : "single generation",
+           next.compact ? ", compacting" : "");
+    gc_resize_heap();
+    pthread_mutex_unlock(&gc_state.lock);
 }
 
 // Get GC statistics
 void gc_stats(void) {
+    pthread_mutex_lock(&gc_state.lock);
+    size_t tlab_unused = gc_flush_all_counters();
+    size_t live = gc_state.heap_used > tlab_unused ? gc_state.heap_used - tlab_unused : 0;
     printf("GC Stats:\n");
-    printf("  Heap size: %zu bytes\n", gc_state.heap_size);
-    printf("  Heap used: %zu bytes (%.1f%%)\n", 
-           gc_state.heap_used, 
-           (double)gc_state.heap_used / gc_state.heap_size * 100);
+    printf("  Heap size: %zu bytes (%d regions, target %zu bytes)\n",
+           gc_state.heap_size, gc_state.region_count, gc_state.heap_target);
+    printf("  Heap used: %zu bytes (%.1f%%, %zu more in allocation buffers)\n",
+           live, (double)live / gc_state.heap_size * 100, tlab_unused);
+    printf("  Next collection at %zu bytes (pace %.2f, collector share %.1f%%)\n",
+           gc_state.next_trigger, gc_state.pace, gc_state.gc_cpu_share * 100);
     
-    int obj_count = 0;
-    for (gc_object_t* curr = gc_state.objects; curr; curr = curr->next) {
-        obj_count++;
-    }
-    printf("  Objects: %d\n", obj_count);
+    printf("  Objects: %d\n", gc_state.object_count);
     
     int free_blocks = 0;
     size_t free_bytes = 0;
-    for (gc_free_block_t* curr = gc_state.free_list; curr; curr = curr->next) {
-        free_blocks++;
-        free_bytes += curr->size;
+    for (int bin = 0; bin < GC_NUM_LARGE_BINS; bin++) {
+        for (gc_free_block_t* curr = gc_state.large_bins[bin]; curr; curr = curr->next) {
+            free_blocks++;
+            free_bytes += curr->size;
+        }
+    }
+    printf("  Large free blocks: %d (%zu bytes)\n", free_blocks, free_bytes);
+    printf("  Fragmentation: %.1f%% of free bytes in small holes (largest free block %zu bytes)\n",
+           gc_state.fragmentation * 100, gc_state.largest_free);
+
+    printf("  Size classes (block size: live / free):\n");
+    for (int i = 0; i < GC_NUM_SIZE_CLASSES; i++) {
+        int live = gc_state.class_live_count[i];
+        int free_count = gc_state.class_free_count[i];
+        if (live == 0 && free_count == 0) continue;
+        printf("    %4zu: %d / %d\n", gc_size_class_size(i), live, free_count);
     }
-    printf("  Free blocks: %d (%zu bytes)\n", free_blocks, free_bytes);
     printf("  Collections: %d\n", gc_state.collection_count);
-    printf("  Allocations: %d\n", gc_state.allocation_count);
+    printf("  Allocations: %d (%llu bytes)\n", gc_state.allocation_count,
+           (unsigned long long)gc_state.allocated_bytes);
+    static const char* const phases[GC_PHASE_COUNT] = { "mark", "sweep", "coalesce", "compact" };
+    for (int p = 0; p < GC_PHASE_COUNT; p++) {
+        if (!gc_state.pause_count[p]) continue;
+        printf("  Pauses (%s): %llu, %.1f us average, %.1f us max\n", phases[p],
+               (unsigned long long)gc_state.pause_count[p],
+               gc_state.pause_total_ns[p] / 1000.0 / gc_state.pause_count[p],
+               gc_state.pause_max_ns[p] / 1000.0);
+    }
+    printf("  Threads: %d\n", gc_state.thread_count);
+    printf("  Roots: %zu registered%s%s\n", gc_state.root_count,
+           gc_state.root_scanner ? ", root scanner" : "",
+           gc_state.config.scan_stacks ? ", stacks scanned" : ", stacks not scanned");
+    if (gc_state.mark_steps) {
+        printf("  Incremental mark: %zu steps, %.1f us average, %.1f us max%s\n",
+               gc_state.mark_steps, gc_state.mark_step_ns / 1000.0 / gc_state.mark_steps,
+               gc_state.mark_step_max_ns / 1000.0, gc_state.marking ? ", cycle in progress" : "");
+    }
+    if (gc_state.sweep_slices) {
+        printf("  Lazy sweep: %zu slices, %zu bytes swept per slice (last %zu), %zu bytes freed, %d regions pending\n",
+               gc_state.sweep_slices, gc_state.sweep_slice_bytes / gc_state.sweep_slices,
+               gc_state.sweep_last_slice_bytes, gc_state.sweep_slice_freed, gc_state.sweep_pending);
+    }
+    if (gc_state.compactions) {
+        printf("  Compactions: %d, %zu objects (%zu bytes) evacuated, %zu pinned in place\n",
+               gc_state.compactions, gc_state.evacuated_objects, gc_state.evacuated_bytes,
+               gc_state.pinned_objects);
+    }
+    if (gc_state.finalizer_count || gc_state.finalize_queue_count || gc_state.finalizers_run ||
+        gc_state.weak_count) {
+        printf("  Finalizers: %zu registered, %zu queued, %llu run; weak references: %zu (%llu cleared)\n",
+               gc_state.finalizer_count, gc_state.finalize_queue_count,
+               (unsigned long long)gc_state.finalizers_run, gc_state.weak_count,
+               (unsigned long long)gc_state.weak_cleared);
+    }
+    if (gc_state.minor_count) {
+        printf("  Minor collections: %d, %.3f ms average, %.3f ms max, %zu bytes promoted, %zu bytes freed\n",
+               gc_state.minor_count, gc_state.minor_ns / 1e6 / gc_state.minor_count,
+               gc_state.minor_max_ns / 1e6, gc_state.promoted_bytes, gc_state.minor_freed_bytes);
+    }
+    pthread_mutex_unlock(&gc_state.lock);
 }
 
 // Macro overrides for standard allocation functions
@@ -0,0 +1,376 @@
+// Allocation and collection benchmarks for gc.h.
+//
+// Usage: gc_bench [-q] [filter]
+//   -q       quick run, every workload scaled down 8x
+//   filter   only run benchmarks whose name starts with it
+//
+// Every result is one line on stdout of space-separated key=value pairs,
+// starting with "bench=<name>"; keys never change meaning between runs, so
+// results can be diffed or grepped to catch regressions. Progress and GC
+// warnings go to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+// glibc entry points, taken before gc.h redirects the names
+static void* libc_malloc(size_t size) { return malloc(size); }
+static void* libc_realloc(void* ptr, size_t size) { return realloc(ptr, size); }
+static void libc_free(void* ptr) { free(ptr); }
+
+#include "gc.h"
+
+static int bench_scale = 1;                                // Divides every workload
+static const char* bench_filter = NULL;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_enabled(const char* name) {
+    return !bench_filter || strncmp(name, bench_filter, strlen(bench_filter)) == 0;
+}
+
+static unsigned long bench_rng = 88172645463325252ul;
+
+static unsigned long bench_rand(void) {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng;
+}
+
+// Drop whatever the previous benchmark left behind
+static void bench_reset_heap(void) {
+    gc_force_collect();
+    gc_sweep_step();
+}
+
+//==============================================================================
+// Allocation throughput by size distribution
+//==============================================================================
+
+// Request sizes of one allocation benchmark
+typedef struct {
+    const char* name;
+    size_t min_size;
+    size_t max_size;                                       // Inclusive, uniform between
+} bench_dist_t;
+
+static const bench_dist_t bench_dists[] = {
+    { "fixed16", 16, 16 },
+    { "fixed64", 64, 64 },
+    { "fixed256", 256, 256 },
+    { "small", 8, 512 },
+    { "medium", 512, 8192 },
+    { "large", 8192, 65536 },
+};
+
+#define BENCH_WINDOW 4096                                  // Objects kept alive at once
+
+static size_t bench_draw(const bench_dist_t* dist) {
+    size_t span = dist->max_size - dist->min_size + 1;
+    return dist->min_size + bench_rand() % span;
+}
+
+// Allocate into a ring of BENCH_WINDOW slots, dropping (gc) or freeing
+// (libc) whatever the slot held, so both see the same live set.
+static void bench_alloc(const bench_dist_t* dist, int use_gc) {
+    long ops = (dist->max_size > 4096 ? 200000 : 4000000) / bench_scale;
+    void** window = use_gc ? gc_malloc(BENCH_WINDOW * sizeof(void*)) :
+                             libc_malloc(BENCH_WINDOW * sizeof(void*));
+    memset(window, 0, BENCH_WINDOW * sizeof(void*));
+
+    bench_rng = 88172645463325252ul;
+    size_t bytes = 0;
+    double start = bench_now();
+    for (long i = 0; i < ops; i++) {
+        size_t size = bench_draw(dist);
+        int slot = i % BENCH_WINDOW;
+        char* p;
+        if (use_gc) {
+            p = gc_malloc(size);
+        } else {
+            libc_free(window[slot]);
+            p = libc_malloc(size);
+        }
+        p[0] = (char)i;
+        window[slot] = p;
+        bytes += size;
+    }
+    double elapsed = bench_now() - start;
+
+    if (!use_gc) {
+        for (int i = 0; i < BENCH_WINDOW; i++) libc_free(window[i]);
+        libc_free(window);
+    }
+    printf("bench=alloc.%s impl=%s ops=%ld bytes=%zu ns_per_op=%.1f mb_per_s=%.1f\n",
+           dist->name, use_gc ? "gc" : "libc", ops, bytes,
+           elapsed * 1e9 / ops, bytes / elapsed / 1e6);
+    fflush(stdout);
+}
+
+static void bench_alloc_all(void) {
+    for (size_t d = 0; d < sizeof(bench_dists) / sizeof(bench_dists[0]); d++) {
+        char name[64];
+        snprintf(name, sizeof(name), "alloc.%s", bench_dists[d].name);
+        if (!bench_enabled(name)) continue;
+        bench_reset_heap();
+        bench_alloc(&bench_dists[d], 1);
+        bench_alloc(&bench_dists[d], 0);
+    }
+}
+
+//==============================================================================
+// Realloc growth patterns
+//==============================================================================
+
+// One buffer grown by step bytes up to final_size, count times over;
+// interleaved grows several buffers in turn so none sits at the heap's end.
+static void bench_realloc(const char* pattern, size_t step, size_t final_size,
+                          int buffers, int use_gc) {
+    int rounds = 64 / bench_scale;
+    long ops = 0;
+    double start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        char* bufs[16] = {0};
+        size_t size = 0;
+        while (size < final_size) {
+            size += step;
+            for (int b = 0; b < buffers; b++) {
+                bufs[b] = use_gc ? gc_realloc(bufs[b], size) : libc_realloc(bufs[b], size);
+                bufs[b][size - 1] = (char)b;
+                ops++;
+            }
+        }
+        if (!use_gc) {
+            for (int b = 0; b < buffers; b++) libc_free(bufs[b]);
+        }
+    }
+    double elapsed = bench_now() - start;
+    printf("bench=realloc.%s impl=%s ops=%ld final_size=%zu ns_per_op=%.1f\n",
+           pattern, use_gc ? "gc" : "libc", ops, final_size, elapsed * 1e9 / ops);
+    fflush(stdout);
+}
+
+static void bench_realloc_all(void) {
+    static const struct {
+        const char* name;
+        size_t step;
+        size_t final_size;
+        int buffers;
+    } patterns[] = {
+        { "append", 16, 256 * 1024, 1 },
+        { "chunked", 4096, 4 * 1024 * 1024, 1 },
+        { "interleaved", 64, 128 * 1024, 8 },
+    };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "realloc.%s", patterns[i].name);
+        if (!bench_enabled(name)) continue;
+        bench_reset_heap();
+        bench_realloc(patterns[i].name, patterns[i].step, patterns[i].final_size,
+                      patterns[i].buffers, 1);
+        bench_realloc(patterns[i].name, patterns[i].step, patterns[i].final_size,
+                      patterns[i].buffers, 0);
+    }
+}
+
+//==============================================================================
+// Full-collection pause against live heap size and graph shape
+//==============================================================================
+
+typedef struct bench_node {
+    struct bench_node* left;
+    struct bench_node* right;
+    long value;
+} bench_node_t;
+
+static void* bench_build_list(size_t count) {
+    bench_node_t* head = NULL;
+    for (size_t i = 0; i < count; i++) {
+        bench_node_t* n = gc_malloc(sizeof(bench_node_t));
+        n->left = head;
+        n->value = (long)i;
+        head = n;
+    }
+    return head;
+}
+
+static bench_node_t* bench_build_tree(int depth) {
+    if (depth == 0) return NULL;
+    bench_node_t* n = gc_malloc(sizeof(bench_node_t));
+    n->left = bench_build_tree(depth - 1);
+    n->right = bench_build_tree(depth - 1);
+    n->value = depth;
+    return n;
+}
+
+static void* bench_build_tree_of(size_t count) {
+    int depth = 1;
+    while (((size_t)2 << depth) - 1 <= count) depth++;
+    return bench_build_tree(depth);
+}
+
+// One pointer array with a small leaf behind every slot
+static void* bench_build_wide(size_t count) {
+    void** array = gc_malloc(count * sizeof(void*));
+    for (size_t i = 0; i < count; i++) {
+        array[i] = gc_malloc(sizeof(long));
+    }
+    return array;
+}
+
+#define BENCH_PAUSE_RUNS 5
+
+static void bench_pause(const char* shape, void* (*build)(size_t), size_t live_mb) {
+    size_t node_bytes = sizeof(gc_object_t) + sizeof(bench_node_t);
+    size_t count = live_mb * 1024 * 1024 / node_bytes;
+
+    bench_reset_heap();
+    void* volatile root = build(count);
+
+    double best = 1e30, worst = 0, total = 0;
+    for (int i = 0; i < BENCH_PAUSE_RUNS; i++) {
+        double start = bench_now();
+        gc_force_collect();
+        double elapsed = bench_now() - start;
+        total += elapsed;
+        if (elapsed < best) best = elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+
+    gc_stats_t stats;
+    gc_get_stats(&stats);
+    printf("bench=pause.%s impl=gc live_mb=%zu objects=%zu live_bytes=%zu "
+           "min_ms=%.3f avg_ms=%.3f max_ms=%.3f\n",
+           shape, live_mb, stats.live_objects, stats.live_bytes,
+           best * 1e3, total * 1e3 / BENCH_PAUSE_RUNS, worst * 1e3);
+    fflush(stdout);
+    root = NULL;
+    (void)root;
+}
+
+static void bench_pause_all(void) {
+    static const struct {
+        const char* name;
+        void* (*build)(size_t);
+    } shapes[] = {
+        { "list", bench_build_list },
+        { "tree", bench_build_tree_of },
+        { "wide", bench_build_wide },
+    };
+    static const size_t sizes_mb[] = { 1, 8, 32, 128 };
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        char name[64];
+        snprintf(name, sizeof(name), "pause.%s", shapes[s].name);
+        if (!bench_enabled(name)) continue;
+        for (size_t i = 0; i < sizeof(sizes_mb) / sizeof(sizes_mb[0]); i++) {
+            size_t mb = sizes_mb[i] / bench_scale;
+            if (!mb) continue;
+            bench_pause(shapes[s].name, shapes[s].build, mb);
+        }
+    }
+}
+
+//==============================================================================
+// Fragmentation over long churn
+//==============================================================================
+
+#define BENCH_CHURN_SLOTS 65536
+#define BENCH_CHURN_REPORTS 8
+
+// Replace random slots of a fixed-size pool with objects of random size,
+// reporting the heap's shape at regular intervals.
+static void bench_churn(int use_gc) {
+    long ops = 8000000 / bench_scale;
+    void** slots = use_gc ? gc_malloc(BENCH_CHURN_SLOTS * sizeof(void*)) :
+                            libc_malloc(BENCH_CHURN_SLOTS * sizeof(void*));
+    memset(slots, 0, BENCH_CHURN_SLOTS * sizeof(void*));
+
+    bench_rng = 88172645463325252ul;
+    size_t live = 0;
+    static size_t sizes[BENCH_CHURN_SLOTS];
+    memset(sizes, 0, sizeof(sizes));
+    double start = bench_now();
+    for (long i = 1; i <= ops; i++) {
+        int slot = bench_rand() % BENCH_CHURN_SLOTS;
+        // Mostly small, with a long tail up to 16 KiB
+        size_t size = bench_rand() % 8 ? 16 + bench_rand() % 240 : 256 + bench_rand() % 16128;
+        if (use_gc) {
+            slots[slot] = gc_malloc(size);
+        } else {
+            libc_free(slots[slot]);
+            slots[slot] = libc_malloc(size);
+        }
+        ((char*)slots[slot])[0] = 1;
+        live += size - sizes[slot];
+        sizes[slot] = size;
+
+        if (i % (ops / BENCH_CHURN_REPORTS) == 0) {
+            if (use_gc) {
+                gc_stats_t stats;
+                gc_get_stats(&stats);
+                printf("bench=churn impl=gc ops=%ld live_bytes=%zu heap_bytes=%zu "
+                       "overhead=%.2f fragmentation=%.3f ns_per_op=%.1f\n",
+                       i, live, stats.heap_size, (double)stats.heap_size / live,
+                       stats.fragmentation, (bench_now() - start) * 1e9 / i);
+            } else {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+                struct mallinfo2 info = mallinfo2();
+                size_t heap = info.arena + info.hblkhd;
+                printf("bench=churn impl=libc ops=%ld live_bytes=%zu heap_bytes=%zu "
+                       "overhead=%.2f fragmentation=%.3f ns_per_op=%.1f\n",
+                       i, live, heap, (double)heap / live,
+                       info.arena ? (double)info.fordblks / info.arena : 0.0,
+                       (bench_now() - start) * 1e9 / i);
+#else
+                printf("bench=churn impl=libc ops=%ld live_bytes=%zu ns_per_op=%.1f\n",
+                       i, live, (bench_now() - start) * 1e9 / i);
+#endif
+            }
+            fflush(stdout);
+        }
+    }
+
+    if (!use_gc) {
+        for (int i = 0; i < BENCH_CHURN_SLOTS; i++) libc_free(slots[i]);
+        libc_free(slots);
+    }
+}
+
+static void bench_churn_all(void) {
+    if (!bench_enabled("churn")) return;
+    bench_reset_heap();
+    bench_churn(1);
+    bench_churn(0);
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            bench_scale = 8;
+        } else {
+            bench_filter = argv[i];
+        }
+    }
+    gc_set_log_stream(stderr);
+
+    bench_alloc_all();
+    bench_realloc_all();
+    bench_pause_all();
+    bench_churn_all();
+    return 0;
+}
@@ -0,0 +1,256 @@
+// Frame-time benchmarks for simple_gui.
+//
+// Usage: gui_bench [-q] [filter]
+//   -q       quick run, 8x fewer frames per scene
+//   filter   only run benchmarks whose name starts with it
+//
+// Scenes of N widgets are rendered into a real window, so an X server is
+// needed; headless machines can provide one with Xvfb:
+//   xvfb-run -s "-screen 0 1280x800x24" ./gui_bench
+//
+// Every result is one line on stdout of space-separated key=value pairs,
+// starting with "bench=<name>"; keys never change meaning between runs, so
+// results can be diffed or grepped to catch regressions. Frame times run
+// from the start of rendering until the server has executed the frame
+// (XSync); the per-stage times and request counts average SGFrameStats.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simple_gui.h"
+
+#define BENCH_WIDTH   1280
+#define BENCH_HEIGHT  800
+#define BENCH_FRAMES  200                                  // Measured frames per scene
+#define BENCH_WARMUP  5                                    // Frames that fill the caches first
+
+static int bench_scale = 1;                                // Divides the frame count
+static const char* bench_filter = NULL;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_enabled(const char* name) {
+    return !bench_filter || strncmp(name, bench_filter, strlen(bench_filter)) == 0;
+}
+
+static int bench_compare_doubles(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Value below which the given percent of the sorted samples fall
+static double bench_percentile(const double* sorted, int count, int percent) {
+    int index = count * percent / 100;
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+// Block until the window's redraw throttle lets the next frame through,
+// handling whatever the server sent meanwhile
+static void bench_wait_frame(SGWindow* sgw) {
+    sg_handle_events(sgw, NULL, 0);
+    int timeout;
+    while ((timeout = sg_frame_timeout(sgw)) > 0) {
+        sg_wait_events(sgw, timeout);
+        sg_handle_events(sgw, NULL, 0);
+    }
+}
+
+// Grid slot of the i-th widget, wrapping around once the window is full
+static void bench_slot(int i, int* x, int* y) {
+    const int cols = (BENCH_WIDTH - 20) / 90;
+    const int rows = (BENCH_HEIGHT - 20) / 32;
+    *x = 10 + (i % cols) * 90 + (i / (cols * rows)) % 7;
+    *y = 10 + (i / cols) % rows * 32;
+}
+
+//==============================================================================
+// Scenes
+//==============================================================================
+
+typedef struct {
+    SGButton* buttons;
+    SGLabel* labels;
+    SGNode* label_nodes;
+    int button_count;
+    int label_count;
+} bench_scene_t;
+
+// A benchmark mode changes something, then renders the frame it caused
+typedef struct {
+    const char* name;
+    int retained;
+    void (*change)(SGWindow* sgw, bench_scene_t* scene, int frame);
+    void (*render)(SGWindow* sgw, bench_scene_t* scene);
+} bench_mode_t;
+
+static void bench_damage_all(SGWindow* sgw, bench_scene_t* scene, int frame) {
+    (void)scene;
+    (void)frame;
+    sg_invalidate_window(sgw);
+}
+
+// One label changes per frame, the way a live readout does
+static void bench_change_label(SGWindow* sgw, bench_scene_t* scene, int frame) {
+    char text[32];
+    snprintf(text, sizeof(text), "Value %d", frame);
+    sg_label_set_text(sg_scene_label(sgw, scene->label_nodes[frame % scene->label_count]), text);
+    sg_scene_update(sgw);
+}
+
+static void bench_render_immediate(SGWindow* sgw, bench_scene_t* scene) {
+    sg_clear_window(sgw);
+    for (int i = 0; i < scene->button_count; i++) sg_draw_button(sgw, &scene->buttons[i]);
+    for (int i = 0; i < scene->label_count; i++) sg_draw_label(sgw, &scene->labels[i]);
+    sg_flush(sgw);
+}
+
+static void bench_render_scene(SGWindow* sgw, bench_scene_t* scene) {
+    (void)scene;
+    sg_scene_render(sgw);
+}
+
+static const bench_mode_t bench_modes[] = {
+    { "immediate",    0, bench_damage_all,   bench_render_immediate },
+    { "scene",        1, bench_damage_all,   bench_render_scene },
+    { "scene.update", 1, bench_change_label, bench_render_scene },
+};
+
+// Three buttons to every label, laid out on a grid
+static void bench_build(bench_scene_t* scene, int widgets) {
+    memset(scene, 0, sizeof(*scene));
+    scene->button_count = widgets * 3 / 4;
+    scene->label_count = widgets - scene->button_count;
+    scene->buttons = calloc((size_t)scene->button_count, sizeof(SGButton));
+    scene->labels = calloc((size_t)scene->label_count, sizeof(SGLabel));
+    scene->label_nodes = calloc((size_t)scene->label_count, sizeof(SGNode));
+
+    char text[32];
+    for (int i = 0; i < widgets; i++) {
+        int x, y;
+        bench_slot(i, &x, &y);
+        if (i % 4 != 3) {
+            snprintf(text, sizeof(text), "B%d", i);
+            scene->buttons[i - i / 4] = sg_create_button(i, x, y, 80, 24, text);
+        } else {
+            snprintf(text, sizeof(text), "Label %d", i);
+            scene->labels[i / 4] = sg_create_label(x, y, text, 12, 0);
+        }
+    }
+}
+
+// Mirror the immediate-mode widgets as nodes of the window's scene
+static void bench_build_retained(SGWindow* sgw, bench_scene_t* scene) {
+    for (int i = 0; i < scene->button_count; i++) {
+        const SGButton* b = &scene->buttons[i];
+        SGNode node = sg_scene_add_button(sgw, SG_SCENE_ROOT, b->id, b->width, b->height, b->text);
+        sg_scene_move(sgw, node, b->x, b->y);
+    }
+    for (int i = 0; i < scene->label_count; i++) {
+        const SGLabel* l = &scene->labels[i];
+        scene->label_nodes[i] = sg_scene_add_label(sgw, SG_SCENE_ROOT, l->text, l->font_size, l->alignment);
+        sg_scene_move(sgw, scene->label_nodes[i], l->x, l->y);
+    }
+}
+
+static void bench_free(bench_scene_t* scene) {
+    for (int i = 0; i < scene->button_count; i++) sg_destroy_button(&scene->buttons[i]);
+    for (int i = 0; i < scene->label_count; i++) sg_destroy_label(&scene->labels[i]);
+    free(scene->buttons);
+    free(scene->labels);
+    free(scene->label_nodes);
+}
+
+static void bench_run(const bench_mode_t* mode, SGBackend backend, int widgets) {
+    char name[64];
+    snprintf(name, sizeof(name), "gui.%s", mode->name);
+    if (!bench_enabled(name)) return;
+
+    SGWindow sgw = sg_create_window_with_backend(BENCH_WIDTH, BENCH_HEIGHT, "gui_bench", backend);
+    bench_scene_t scene;
+    bench_build(&scene, widgets);
+    if (mode->retained) bench_build_retained(&sgw, &scene);
+
+    const int frames = BENCH_FRAMES / bench_scale;
+    double* samples = malloc((size_t)frames * sizeof(double));
+    SGFrameStats sum = {0};
+    for (int i = -BENCH_WARMUP; i < frames; i++) {
+        mode->change(&sgw, &scene, i + BENCH_WARMUP);
+
+        // Waiting out the redraw throttle is not part of the frame
+        bench_wait_frame(&sgw);
+        const double start = bench_now();
+        mode->render(&sgw, &scene);
+        XSync(sgw.display, False);
+        const double elapsed = bench_now() - start;
+        if (i < 0) continue;
+
+        SGFrameStats stats;
+        sg_get_frame_stats(&sgw, &stats);
+        samples[i] = elapsed * 1e3;
+        sum.clear_ms += stats.clear_ms;
+        sum.shapes_ms += stats.shapes_ms;
+        sum.buttons_ms += stats.buttons_ms;
+        sum.labels_ms += stats.labels_ms;
+        sum.flush_ms += stats.flush_ms;
+        sum.requests += stats.requests;
+        sum.skipped = stats.skipped;
+    }
+
+    qsort(samples, (size_t)frames, sizeof(double), bench_compare_doubles);
+    printf("bench=%s backend=%s widgets=%d frames=%d p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f "
+           "clear_ms=%.3f shapes_ms=%.3f buttons_ms=%.3f labels_ms=%.3f flush_ms=%.3f requests=%lu "
+           "skipped=%lu\n",
+           name, sgw.backend == SG_BACKEND_IMAGE ? "image" : "xlib", widgets, frames,
+           bench_percentile(samples, frames, 50), bench_percentile(samples, frames, 90),
+           bench_percentile(samples, frames, 99), samples[frames - 1],
+           sum.clear_ms / frames, sum.shapes_ms / frames, sum.buttons_ms / frames,
+           sum.labels_ms / frames, sum.flush_ms / frames, sum.requests / (unsigned long)frames,
+           sum.skipped);
+    fflush(stdout);
+
+    free(samples);
+    bench_free(&scene);
+    sg_destroy_window(&sgw);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            bench_scale = 8;
+        } else {
+            bench_filter = argv[i];
+        }
+    }
+
+    // sg_create_window exits without a display, so say what is missing first
+    Display* probe = XOpenDisplay(NULL);
+    if (!probe) {
+        fprintf(stderr, "gui_bench: cannot open an X display; run it under Xvfb, "
+                        "e.g. xvfb-run ./gui_bench\n");
+        return 1;
+    }
+    XCloseDisplay(probe);
+
+    static const int sizes[] = { 100, 1000, 4000 };
+    static const SGBackend backends[] = { SG_BACKEND_XLIB, SG_BACKEND_IMAGE };
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (size_t m = 0; m < sizeof(bench_modes) / sizeof(bench_modes[0]); m++) {
+                bench_run(&bench_modes[m], backends[b], sizes[s]);
+            }
+        }
+    }
+    return 0;
+}
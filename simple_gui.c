@@ -1,10 +1,18 @@
 #include "simple_gui.h"
 #include <X11/Xutil.h>
 #include <X11/Xft/Xft.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xrender.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
+#include <limits.h>
 
 //==============================================================================
 // Color Palette & Style Definitions
@@ -26,41 +34,163 @@
 #define BTN_PRESSED_BOTTOM   0x88C0D0 // Nord Frost
 
 // Performance and resource management constants
-#define MAX_CACHED_FONTS     8        // Maximum number of cached fonts
+#define MAX_CACHED_FONTS     8        // Default capacity of the font cache
+#define FONT_CACHE_BUCKETS   64       // Hash buckets of the font cache
 #define FONT_NAME_MAX_LEN    64       // Maximum font name length
+#define MAX_CACHED_GRADIENTS 32       // Maximum number of cached gradient strips
+#define MAX_CACHED_MASKS     16       // Maximum number of cached button masks
+#define MAX_CACHED_FACES     64       // Maximum number of pre-rendered button faces
+#define WIDGET_GRID_CELL     64       // Smallest cell size of the hit-test grid
+#define MAX_CACHED_RUNS      256      // Maximum number of cached glyph runs
+#define GLYPH_RUN_BUCKETS    512      // Hash buckets of the glyph run cache
 #define MIN_REDRAW_INTERVAL  16       // Minimum ms between redraws (60 FPS)
+#define BUFFER_GROW_STEP     64       // Back buffers grow in steps of this many pixels
+#define SCENE_CHUNK          256      // Scene nodes per arena chunk
 
 //==============================================================================
 // Resource Management
 //==============================================================================
 
-// Font cache entry for improved memory management
+// Font cache entry, hashed by (display, base name, size) and kept on an
+// LRU list; links hold slot + 1 so that 0 ends a list
 typedef struct {
-    XftFont* font;
+    XftFont* font;      // NULL for a free slot
+    Display* display;
     char name[FONT_NAME_MAX_LEN];
     int size;
-    int ref_count;
-    bool in_use;
+    unsigned long hash;
+    unsigned long serial;
+    unsigned long last_used;
+    int chain;          // Next entry in the same hash bucket
+    int lru_prev;       // More recently used neighbour
+    int lru_next;       // Less recently used neighbour
 } FontCacheEntry;
 
-// Global resource management structure
+// Gradient cache entry: a 1-pixel-wide strip holding one color per row,
+// tiled across any rectangle of the same height
 typedef struct {
-    // Font cache
-    FontCacheEntry font_cache[MAX_CACHED_FONTS];
-    int font_cache_size;
+    Display* display;
+    Pixmap strip;
+    int height;
+    unsigned long top;
+    unsigned long bottom;
+    unsigned long last_used;
+} GradientCacheEntry;
+
+// Kinds of 1-bit button masks
+enum {
+    MASK_SHAPE,    // The rounded face alone, used to clip its gradient
+    MASK_RAISED,   // Face, border and drop shadow of an idle or hovered button
+    MASK_PRESSED   // Face and border of a pressed button, inset without shadow
+};
+
+// Button states with their own pre-rendered face
+enum {
+    FACE_IDLE,
+    FACE_HOVER,
+    FACE_PRESSED
+};
+
+// Mask cache entry, keyed by (w, h, radius, kind)
+typedef struct {
+    Pixmap mask;
+    int width, height, radius, kind;
+    unsigned long last_used;
+} MaskCacheEntry;
+
+// Button face cache entry: a button fully rendered in one state, keyed by
+// its size and text so identical buttons share it
+typedef struct {
+    Pixmap face;
+    int width, height, state;
+    unsigned long hash;
+    char* text;
+    unsigned long last_used;
+} FaceCacheEntry;
+
+/**
+ * @brief Text shaped into glyph indices and measured, for one font
+ *
+ * Slots are reused in place, so 'serial' changes whenever a slot starts
+ * holding a different run; widgets compare it to spot a stale handle.
+ */
+struct SGGlyphRun {
+    XftFont* font;
+    char* text;
+    unsigned long hash;
+    FT_UInt* glyphs;
+    int* pen_x;            // Pen position of each glyph, from the run's origin
+    int glyph_count;
+    XGlyphInfo extents;
+    unsigned long serial;
+    unsigned long last_used;
+    int next;              // Next slot + 1 in the same hash bucket, 0 at the end
+};
+
+// Resources shared by every window on one X connection: the window that
+// opened it and those made from it with sg_create_shared_window
+struct SGDisplayResources {
+    Display* display;
+    int ref_count;         // Windows on the connection, which closes with the last
+    
+    // Button masks and faces, with the GCs and XftDraw that render them
+    MaskCacheEntry mask_cache[MAX_CACHED_MASKS];
+    FaceCacheEntry face_cache[MAX_CACHED_FACES];
+    unsigned long button_clock;
+    GC mask_gc;
+    GC face_gc;
+    XftDraw* face_draw;
     
-    // Xft resources
-    XftDraw* draw;
     XftColor text_color;
-    Pixmap last_drawable;
-    Display* last_display;
+    bool color_allocated;
     
-    // Performance tracking
+    struct SGDisplayResources* next;
+};
+
+// Resources owned by one window
+struct SGWindowResources {
+    struct SGDisplayResources* shared;
+    XftDraw* draw;         // Draws into 'drawable'
+    Drawable drawable;     // None until bound, and again once the back buffer goes
     unsigned long last_redraw_time;
     
-    // Initialization flags
-    bool xft_initialized;
-    bool resources_initialized;
+    // Frame statistics: the last presented frame and the one being drawn
+    SGFrameStats stats;
+    SGFrameStats current;
+    double frame_start;
+    unsigned long first_request;
+};
+
+// Global resource management structure
+typedef struct {
+    // Font cache
+    FontCacheEntry* font_cache;
+    int font_cache_slots;   // Allocated entries, never shrinks
+    int font_cache_limit;   // Configured capacity, 0 for MAX_CACHED_FONTS
+    int font_count;
+    int font_buckets[FONT_CACHE_BUCKETS];
+    int font_lru_head;      // Most recently used
+    int font_lru_tail;      // Least recently used
+    unsigned long font_clock;
+    unsigned long font_serial;
+    unsigned long font_sweep_clock;
+    unsigned long font_hits;
+    unsigned long font_misses;
+    unsigned long font_evictions;
+    
+    // Gradient cache
+    GradientCacheEntry gradient_cache[MAX_CACHED_GRADIENTS];
+    int gradient_cache_size;
+    unsigned long gradient_clock;
+    
+    // Glyph runs, hashed by (font, text)
+    struct SGGlyphRun glyph_runs[MAX_CACHED_RUNS];
+    int run_buckets[GLYPH_RUN_BUCKETS]; // Slot index + 1, 0 for an empty bucket
+    unsigned long run_clock;
+    unsigned long run_serial;
+    
+    // Per-display resources of the open windows
+    struct SGDisplayResources* displays;
 } SGResourceManager;
 
 // Global resource manager instance
@@ -79,6 +209,13 @@ static unsigned long get_time_ms(void) {
     return 0;
 }
 
+// Monotonic time with sub-millisecond resolution, for frame statistics
+static double get_frame_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
 // error handling with detailed messages
 static void sg_log_error(const char* function, const char* message) {
     fprintf(stderr, "[SimpleGUI Error] %s: %s\n", function, message);
@@ -98,6 +235,16 @@ static void* sg_safe_malloc(size_t size) {
     return ptr;
 }
 
+// Safe memory reallocation with error checking
+static void* sg_safe_realloc(void* ptr, size_t size) {
+    void* grown = realloc(ptr, size);
+    if (!grown && size > 0) {
+        sg_log_error("sg_safe_realloc", "Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
 // Safe string duplication
 static char* sg_safe_strdup(const char* str) {
     if (!str) return NULL;
@@ -109,61 +256,302 @@ static char* sg_safe_strdup(const char* str) {
 }
 
 //==============================================================================
-// Font Management
+// Damage Tracking
 //==============================================================================
 
-// Find cached font by name and size
-static FontCacheEntry* find_cached_font(const char* name, int size) {
-    for (int i = 0; i < g_rm.font_cache_size; i++) {
-        if (g_rm.font_cache[i].in_use && 
-            g_rm.font_cache[i].size == size &&
-            strcmp(g_rm.font_cache[i].name, name) == 0) {
-            return &g_rm.font_cache[i];
-        }
+static bool rect_is_empty(const SGRect* r) {
+    return r->width <= 0 || r->height <= 0;
+}
+
+// Grow 'dst' to the bounding box of itself and 'src'
+static void rect_union(SGRect* dst, const SGRect* src) {
+    if (rect_is_empty(src)) return;
+    if (rect_is_empty(dst)) {
+        *dst = *src;
+        return;
     }
-    return NULL;
+    
+    const int x1 = (dst->x < src->x) ? dst->x : src->x;
+    const int y1 = (dst->y < src->y) ? dst->y : src->y;
+    const int x2 = (dst->x + dst->width > src->x + src->width) ? dst->x + dst->width : src->x + src->width;
+    const int y2 = (dst->y + dst->height > src->y + src->height) ? dst->y + dst->height : src->y + src->height;
+    *dst = (SGRect){ x1, y1, x2 - x1, y2 - y1 };
 }
 
-// Get font with improved caching and error handling
-static XftFont* get_cached_font(Display* display, const char* base_name, int size) {
-    if (!display || !base_name || size <= 0) return NULL;
+static bool rect_intersects(const SGRect* a, const SGRect* b) {
+    return !rect_is_empty(a) && !rect_is_empty(b) &&
+           a->x < b->x + b->width && b->x < a->x + a->width &&
+           a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static bool rect_contains(const SGRect* outer, const SGRect* inner) {
+    return !rect_is_empty(outer) &&
+           inner->x >= outer->x && inner->x + inner->width <= outer->x + outer->width &&
+           inner->y >= outer->y && inner->y + inner->height <= outer->y + outer->height;
+}
+
+// Add a rectangle, clipped to the window, to the area repainted next frame
+static void damage_rect(SGWindow* sgw, SGRect r) {
+    if (r.x < 0) { r.width += r.x; r.x = 0; }
+    if (r.y < 0) { r.height += r.y; r.y = 0; }
+    if (r.x + r.width > sgw->width) r.width = sgw->width - r.x;
+    if (r.y + r.height > sgw->height) r.height = sgw->height - r.y;
+    rect_union(&sgw->damage, &r);
+}
+
+// Area a button paints, including its drop shadow
+static SGRect button_bounds(const SGButton* button) {
+    return (SGRect){ button->x, button->y, 
+                     button->width + SHADOW_OFFSET, button->height + SHADOW_OFFSET };
+}
+
+// Widget changes found while drawing are repainted next frame, unless the
+// current frame already covers them
+static void damage_late(SGWindow* sgw, const SGRect* r) {
+    if (!rect_contains(&sgw->frame, r)) {
+        damage_rect(sgw, *r);
+    }
+}
+
+static XRectangle frame_clip(const SGWindow* sgw) {
+    return (XRectangle){ (short)sgw->frame.x, (short)sgw->frame.y, 
+                         (unsigned short)sgw->frame.width, (unsigned short)sgw->frame.height };
+}
+
+//==============================================================================
+// Glyph Runs
+//==============================================================================
+
+static unsigned long hash_glyph_run(const XftFont* font, const char* text) {
+    unsigned long hash = 2166136261UL ^ (unsigned long)(uintptr_t)font;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash = (hash ^ *p) * 16777619UL;
+    }
+    return hash;
+}
+
+static int* glyph_run_bucket(unsigned long hash) {
+    return &g_rm.run_buckets[hash % GLYPH_RUN_BUCKETS];
+}
+
+// Unlink a slot from its bucket and free what it holds
+static void release_glyph_run(int slot) {
+    struct SGGlyphRun* run = &g_rm.glyph_runs[slot];
+    if (!run->font) return;
     
-    char font_name[FONT_NAME_MAX_LEN];
-    snprintf(font_name, sizeof(font_name), "%s-%d", base_name, size);
+    int* link = glyph_run_bucket(run->hash);
+    while (*link && *link - 1 != slot) {
+        link = &g_rm.glyph_runs[*link - 1].next;
+    }
+    if (*link) *link = run->next;
     
-    // Check if font is already cached
-    FontCacheEntry* entry = find_cached_font(font_name, size);
-    if (entry) {
-        entry->ref_count++;
-        return entry->font;
+    free(run->text);
+    free(run->glyphs);
+    free(run->pen_x);
+    run->text = NULL;
+    run->glyphs = NULL;
+    run->pen_x = NULL;
+    run->font = NULL;
+}
+
+// Drop every run shaped with a font that is about to be closed
+static void purge_glyph_runs(const XftFont* font) {
+    for (int i = 0; i < MAX_CACHED_RUNS; i++) {
+        if (g_rm.glyph_runs[i].font && (!font || g_rm.glyph_runs[i].font == font)) {
+            release_glyph_run(i);
+        }
     }
+}
+
+// Get the run of 'text' in 'font', decoding and measuring it on a miss and
+// evicting the least recently used run when the cache is full
+static struct SGGlyphRun* get_glyph_run(Display* display, XftFont* font, const char* text) {
+    const unsigned long hash = hash_glyph_run(font, text);
+    int* bucket = glyph_run_bucket(hash);
+    g_rm.run_clock++;
     
-    // Find available cache slot
-    int slot = -1;
-    for (int i = 0; i < MAX_CACHED_FONTS; i++) {
-        if (!g_rm.font_cache[i].in_use) {
+    for (int i = *bucket; i; i = g_rm.glyph_runs[i - 1].next) {
+        struct SGGlyphRun* run = &g_rm.glyph_runs[i - 1];
+        if (run->hash == hash && run->font == font && strcmp(run->text, text) == 0) {
+            run->last_used = g_rm.run_clock;
+            return run;
+        }
+    }
+    
+    // Find available cache slot, or the least recently used one
+    int slot = 0;
+    for (int i = 0; i < MAX_CACHED_RUNS; i++) {
+        if (!g_rm.glyph_runs[i].font) {
             slot = i;
             break;
         }
+        if (g_rm.glyph_runs[i].last_used < g_rm.glyph_runs[slot].last_used) {
+            slot = i;
+        }
     }
+    release_glyph_run(slot);
     
-    // If no slot available, find least recently used
-    if (slot == -1) {
-        int min_ref = INT_MAX;
-        for (int i = 0; i < MAX_CACHED_FONTS; i++) {
-            if (g_rm.font_cache[i].ref_count < min_ref) {
-                min_ref = g_rm.font_cache[i].ref_count;
-                slot = i;
-            }
-        }
-        
-        // Clean up old font
-        if (g_rm.font_cache[slot].font) {
-            XftFontClose(display, g_rm.font_cache[slot].font);
+    // UTF-8 never has more characters than bytes
+    const int length = (int)strlen(text);
+    FT_UInt* glyphs = sg_safe_malloc((size_t)(length + 1) * sizeof(FT_UInt));
+    int count = 0;
+    for (int offset = 0; offset < length; ) {
+        FcChar32 ucs4;
+        const int n = FcUtf8ToUcs4((const FcChar8*)text + offset, &ucs4, length - offset);
+        if (n <= 0) break;
+        offset += n;
+        glyphs[count++] = XftCharIndex(display, font, ucs4);
+    }
+    
+    // Batched text places every glyph itself, so keep where each one goes
+    int* pen_x = sg_safe_malloc((size_t)(count + 1) * sizeof(int));
+    int pen = 0;
+    for (int i = 0; i < count; i++) {
+        XGlyphInfo info;
+        XftGlyphExtents(display, font, &glyphs[i], 1, &info);
+        pen_x[i] = pen;
+        pen += info.xOff;
+    }
+    
+    struct SGGlyphRun* run = &g_rm.glyph_runs[slot];
+    run->font = font;
+    run->text = sg_safe_strdup(text);
+    run->hash = hash;
+    run->glyphs = glyphs;
+    run->pen_x = pen_x;
+    run->glyph_count = count;
+    XftGlyphExtents(display, font, glyphs, count, &run->extents);
+    run->serial = ++g_rm.run_serial;
+    run->last_used = g_rm.run_clock;
+    run->next = *bucket;
+    *bucket = slot + 1;
+    return run;
+}
+
+// Resolve a widget's run, going through the shared cache only when the
+// widget's handle is stale
+static struct SGGlyphRun* resolve_glyph_run(Display* display, XftFont* font, const char* text, SGTextCache* cache) {
+    struct SGGlyphRun* run = cache->run;
+    if (run && run->serial == cache->serial && run->font == font && cache->text == text) {
+        run->last_used = ++g_rm.run_clock;
+        return run;
+    }
+    
+    run = get_glyph_run(display, font, text);
+    *cache = (SGTextCache){ run, run->serial, text };
+    return run;
+}
+
+//==============================================================================
+// Font Management
+//==============================================================================
+
+// Font cache entries are linked by slot + 1, with 0 ending a list
+static FontCacheEntry* font_slot(int link) {
+    return link ? &g_rm.font_cache[link - 1] : NULL;
+}
+
+static int font_cache_limit(void) {
+    return (g_rm.font_cache_limit > 0) ? g_rm.font_cache_limit : MAX_CACHED_FONTS;
+}
+
+static unsigned long hash_font(const Display* display, const char* base_name, int size) {
+    unsigned long hash = 2166136261UL ^ (unsigned long)(uintptr_t)display;
+    for (const unsigned char* p = (const unsigned char*)base_name; *p; p++) {
+        hash = (hash ^ *p) * 16777619UL;
+    }
+    return (hash ^ (unsigned long)size) * 16777619UL;
+}
+
+static void font_lru_unlink(int slot) {
+    FontCacheEntry* entry = &g_rm.font_cache[slot];
+    if (entry->lru_prev) font_slot(entry->lru_prev)->lru_next = entry->lru_next;
+    else g_rm.font_lru_head = entry->lru_next;
+    if (entry->lru_next) font_slot(entry->lru_next)->lru_prev = entry->lru_prev;
+    else g_rm.font_lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = 0;
+}
+
+static void font_lru_push_front(int slot) {
+    FontCacheEntry* entry = &g_rm.font_cache[slot];
+    entry->lru_prev = 0;
+    entry->lru_next = g_rm.font_lru_head;
+    if (g_rm.font_lru_head) font_slot(g_rm.font_lru_head)->lru_prev = slot + 1;
+    else g_rm.font_lru_tail = slot + 1;
+    g_rm.font_lru_head = slot + 1;
+}
+
+// Record a use: the font becomes the most recently used one
+static void touch_font(int slot) {
+    g_rm.font_cache[slot].last_used = ++g_rm.font_clock;
+    if (g_rm.font_lru_head != slot + 1) {
+        font_lru_unlink(slot);
+        font_lru_push_front(slot);
+    }
+}
+
+static void close_cached_font(int slot) {
+    FontCacheEntry* entry = &g_rm.font_cache[slot];
+    if (!entry->font) return;
+    
+    int* link = &g_rm.font_buckets[entry->hash % FONT_CACHE_BUCKETS];
+    while (*link && *link != slot + 1) {
+        link = &font_slot(*link)->chain;
+    }
+    if (*link) *link = entry->chain;
+    font_lru_unlink(slot);
+    
+    purge_glyph_runs(entry->font);
+    XftFontClose(entry->display, entry->font);
+    entry->font = NULL;
+    g_rm.font_count--;
+}
+
+// Get font with caching: a hash lookup on (display, name, size), loading
+// the font on a miss and evicting the least recently used one when full
+static XftFont* lookup_font(Display* display, const char* base_name, int size, int* slot_out) {
+    if (!display || !base_name || size <= 0) return NULL;
+    
+    const unsigned long hash = hash_font(display, base_name, size);
+    int* bucket = &g_rm.font_buckets[hash % FONT_CACHE_BUCKETS];
+    
+    // Check if font is already cached
+    for (int link = *bucket; link; link = font_slot(link)->chain) {
+        FontCacheEntry* entry = font_slot(link);
+        if (entry->hash == hash && entry->display == display && entry->size == size &&
+            strcmp(entry->name, base_name) == 0) {
+            g_rm.font_hits++;
+            touch_font(link - 1);
+            *slot_out = link - 1;
+            return entry->font;
         }
     }
+    g_rm.font_misses++;
+    
+    // Make room by closing the least recently used fonts
+    const int limit = font_cache_limit();
+    while (g_rm.font_count >= limit && g_rm.font_lru_tail) {
+        close_cached_font(g_rm.font_lru_tail - 1);
+        g_rm.font_evictions++;
+    }
+    
+    // Slots only ever grow, so handles keep pointing at the right entry
+    if (g_rm.font_cache_slots < limit) {
+        g_rm.font_cache = sg_safe_realloc(g_rm.font_cache, (size_t)limit * sizeof(FontCacheEntry));
+        memset(&g_rm.font_cache[g_rm.font_cache_slots], 0, 
+               (size_t)(limit - g_rm.font_cache_slots) * sizeof(FontCacheEntry));
+        g_rm.font_cache_slots = limit;
+    }
+    
+    int slot = 0;
+    while (slot < g_rm.font_cache_slots && g_rm.font_cache[slot].font) {
+        slot++;
+    }
+    if (slot == g_rm.font_cache_slots) return NULL;
     
     // Load new font
+    char font_name[FONT_NAME_MAX_LEN];
+    snprintf(font_name, sizeof(font_name), "%s-%d", base_name, size);
     XftFont* font = XftFontOpenName(display, DefaultScreen(display), font_name);
     if (!font) {
         sg_log_error("get_cached_font", "Failed to load font");
@@ -171,123 +559,301 @@ static XftFont* get_cached_font(Display* display, const char* base_name, int siz
     }
     
     // Cache the font
-    FontCacheEntry* new_entry = &g_rm.font_cache[slot];
-    new_entry->font = font;
-    strncpy(new_entry->name, font_name, FONT_NAME_MAX_LEN - 1);
-    new_entry->name[FONT_NAME_MAX_LEN - 1] = '\0';
-    new_entry->size = size;
-    new_entry->ref_count = 1;
-    new_entry->in_use = true;
+    FontCacheEntry* entry = &g_rm.font_cache[slot];
+    entry->font = font;
+    entry->display = display;
+    strncpy(entry->name, base_name, FONT_NAME_MAX_LEN - 1);
+    entry->name[FONT_NAME_MAX_LEN - 1] = '\0';
+    entry->size = size;
+    entry->hash = hash;
+    entry->serial = ++g_rm.font_serial;
+    entry->chain = *bucket;
+    *bucket = slot + 1;
+    font_lru_push_front(slot);
+    entry->last_used = ++g_rm.font_clock;
+    g_rm.font_count++;
     
-    if (slot >= g_rm.font_cache_size) {
-        g_rm.font_cache_size = slot + 1;
+    *slot_out = slot;
+    return font;
+}
+
+static XftFont* get_cached_font(Display* display, const char* base_name, int size) {
+    int slot;
+    return lookup_font(display, base_name, size, &slot);
+}
+
+// Resolve a widget's font, skipping the lookup while its handle is valid
+static XftFont* resolve_font(Display* display, const char* base_name, int size, SGFontHandle* handle) {
+    FontCacheEntry* entry = (handle->slot <= g_rm.font_cache_slots) ? font_slot(handle->slot) : NULL;
+    if (entry && entry->font && entry->serial == handle->serial && 
+        entry->display == display && handle->size == size) {
+        g_rm.font_hits++;
+        touch_font(handle->slot - 1);
+        return entry->font;
     }
     
+    int slot;
+    XftFont* font = lookup_font(display, base_name, size, &slot);
+    *handle = font ? (SGFontHandle){ slot + 1, g_rm.font_cache[slot].serial, size } : (SGFontHandle){0};
     return font;
 }
 
-// Cleanup font cache
+// Cleanup font cache, for one display or all of them
 static void cleanup_font_cache(Display* display) {
-    for (int i = 0; i < g_rm.font_cache_size; i++) {
-        if (g_rm.font_cache[i].in_use && g_rm.font_cache[i].font) {
-            XftFontClose(display, g_rm.font_cache[i].font);
-            g_rm.font_cache[i].in_use = false;
+    for (int i = 0; i < g_rm.font_cache_slots; i++) {
+        if (g_rm.font_cache[i].font && (!display || g_rm.font_cache[i].display == display)) {
+            close_cached_font(i);
         }
     }
-    g_rm.font_cache_size = 0;
 }
 
 //==============================================================================
-// Resource Management
+// Gradient Management
 //==============================================================================
 
-// Initialize Xft resources with error checking
-static bool initialize_xft_resources(Display* display, Drawable drawable) {
-    if (g_rm.xft_initialized && g_rm.last_drawable == drawable && g_rm.last_display == display) {
-        return true; 
+// Color of row 'i' of a gradient 'h' rows tall
+static unsigned long gradient_row_color(int i, int h, unsigned long c_top, unsigned long c_bottom) {
+    // Extract RGB components with improved bit manipulation
+    const int r1 = (c_top >> 16) & 0xFF;
+    const int g1 = (c_top >> 8)  & 0xFF;
+    const int b1 = c_top & 0xFF;
+    
+    const int r_delta = ((int)((c_bottom >> 16) & 0xFF)) - r1;
+    const int g_delta = ((int)((c_bottom >> 8)  & 0xFF)) - g1;
+    const int b_delta = ((int)(c_bottom & 0xFF)) - b1;
+    
+    // Use more precise color interpolation
+    const unsigned char r = (unsigned char)(r1 + (r_delta * i) / h);
+    const unsigned char g = (unsigned char)(g1 + (g_delta * i) / h);
+    const unsigned char b = (unsigned char)(b1 + (b_delta * i) / h);
+    
+    return ((unsigned long)r << 16) | ((unsigned long)g << 8) | b;
+}
+
+// Render a gradient strip with a single image upload
+static Pixmap create_gradient_strip(Display* display, Drawable d, int h, unsigned long c_top, unsigned long c_bottom) {
+    const int screen = DefaultScreen(display);
+    const int depth = DefaultDepth(display, screen);
+    
+    XImage* image = XCreateImage(display, DefaultVisual(display, screen), depth, ZPixmap, 
+                                 0, NULL, 1, h, 32, 0);
+    if (!image) return None;
+    
+    image->data = malloc((size_t)image->bytes_per_line * h);
+    if (!image->data) {
+        XDestroyImage(image);
+        return None;
+    }
+    
+    for (int i = 0; i < h; i++) {
+        XPutPixel(image, 0, i, gradient_row_color(i, h, c_top, c_bottom));
     }
     
-    // Clean up old resources if display changed
-    if (g_rm.last_display != display && g_rm.xft_initialized) {
-        if (g_rm.draw) {
-            XftDrawDestroy(g_rm.draw);
-            g_rm.draw = NULL;
+    Pixmap strip = XCreatePixmap(display, d, 1, h, depth);
+    GC strip_gc = XCreateGC(display, strip, 0, NULL);
+    XPutImage(display, strip, strip_gc, image, 0, 0, 0, 0, 1, h);
+    XFreeGC(display, strip_gc);
+    XDestroyImage(image);
+    return strip;
+}
+
+// Get the strip for a gradient, rendering it on a miss and evicting the
+// least recently used entry when the cache is full
+static Pixmap get_cached_gradient(Display* display, Drawable d, int h, unsigned long c_top, unsigned long c_bottom) {
+    g_rm.gradient_clock++;
+    
+    for (int i = 0; i < g_rm.gradient_cache_size; i++) {
+        GradientCacheEntry* entry = &g_rm.gradient_cache[i];
+        if (entry->strip && entry->display == display && entry->height == h &&
+            entry->top == c_top && entry->bottom == c_bottom) {
+            entry->last_used = g_rm.gradient_clock;
+            return entry->strip;
         }
-        cleanup_font_cache(g_rm.last_display);
-        g_rm.xft_initialized = false;
     }
     
-    // Create or recreate XftDraw if drawable changed
-    if (g_rm.last_drawable != drawable) {
-        if (g_rm.draw) {
-            XftDrawDestroy(g_rm.draw);
+    // Find available cache slot, or the least recently used one
+    int slot = -1;
+    for (int i = 0; i < MAX_CACHED_GRADIENTS; i++) {
+        if (!g_rm.gradient_cache[i].strip) {
+            slot = i;
+            break;
         }
-        
-        g_rm.draw = XftDrawCreate(display, drawable, 
-                                 DefaultVisual(display, DefaultScreen(display)),
-                                 DefaultColormap(display, DefaultScreen(display)));
-        if (!g_rm.draw) {
-            sg_log_error("initialize_xft_resources", "Failed to create XftDraw");
-            return false;
+        if (slot == -1 || g_rm.gradient_cache[i].last_used < g_rm.gradient_cache[slot].last_used) {
+            slot = i;
         }
-        g_rm.last_drawable = drawable;
     }
     
-    // Initialize color if not done yet
-    if (!g_rm.xft_initialized) {
-        if (!XftColorAllocName(display, 
-                              DefaultVisual(display, DefaultScreen(display)),
-                              DefaultColormap(display, DefaultScreen(display)),
-                              "#ECEFF4", &g_rm.text_color)) {
-            sg_log_error("initialize_xft_resources", "Failed to allocate text color");
-            return false;
+    GradientCacheEntry* entry = &g_rm.gradient_cache[slot];
+    if (entry->strip) {
+        XFreePixmap(entry->display, entry->strip);
+        entry->strip = None;
+    }
+    
+    Pixmap strip = create_gradient_strip(display, d, h, c_top, c_bottom);
+    if (!strip) return None;
+    
+    *entry = (GradientCacheEntry){ display, strip, h, c_top, c_bottom, g_rm.gradient_clock };
+    if (slot >= g_rm.gradient_cache_size) {
+        g_rm.gradient_cache_size = slot + 1;
+    }
+    return strip;
+}
+
+// Drop a gradient that will not be drawn again, such as the background of
+// a window that was just resized
+static void invalidate_cached_gradient(Display* display, int h, unsigned long c_top, unsigned long c_bottom) {
+    for (int i = 0; i < g_rm.gradient_cache_size; i++) {
+        GradientCacheEntry* entry = &g_rm.gradient_cache[i];
+        if (entry->strip && entry->display == display && entry->height == h &&
+            entry->top == c_top && entry->bottom == c_bottom) {
+            XFreePixmap(display, entry->strip);
+            entry->strip = None;
+        }
+    }
+}
+
+// Cleanup gradient cache
+static void cleanup_gradient_cache(Display* display) {
+    for (int i = 0; i < g_rm.gradient_cache_size; i++) {
+        GradientCacheEntry* entry = &g_rm.gradient_cache[i];
+        if (entry->strip && entry->display == display) {
+            XFreePixmap(display, entry->strip);
+            entry->strip = None;
+        }
+    }
+}
+
+//==============================================================================
+// Resource Management
+//==============================================================================
+
+// Get the resources of a display, creating them for its first window
+static struct SGDisplayResources* acquire_display_resources(Display* display) {
+    for (struct SGDisplayResources* dr = g_rm.displays; dr; dr = dr->next) {
+        if (dr->display == display) {
+            dr->ref_count++;
+            return dr;
         }
-        g_rm.xft_initialized = true;
     }
     
-    g_rm.last_display = display;
+    struct SGDisplayResources* dr = sg_safe_malloc(sizeof(*dr));
+    memset(dr, 0, sizeof(*dr));
+    dr->display = display;
+    dr->ref_count = 1;
+    
+    dr->color_allocated = XftColorAllocName(display, 
+                                            DefaultVisual(display, DefaultScreen(display)),
+                                            DefaultColormap(display, DefaultScreen(display)),
+                                            "#ECEFF4", &dr->text_color);
+    if (!dr->color_allocated) {
+        sg_log_error("acquire_display_resources", "Failed to allocate text color");
+    }
+    
+    dr->next = g_rm.displays;
+    g_rm.displays = dr;
+    return dr;
+}
+
+static void cleanup_button_cache(struct SGDisplayResources* dr);
+
+// Drop a window's hold on its display, freeing everything cached for the
+// display with the last window. Returns whether that was the last window,
+// which leaves the connection for the caller to close.
+static bool release_display_resources(struct SGDisplayResources* dr) {
+    if (!dr) return true;
+    if (--dr->ref_count > 0) return false;
+    
+    Display* display = dr->display;
+    cleanup_button_cache(dr);
+    cleanup_gradient_cache(display);
+    cleanup_font_cache(display);
+    if (dr->color_allocated) {
+        XftColorFree(display, DefaultVisual(display, DefaultScreen(display)),
+                     DefaultColormap(display, DefaultScreen(display)), &dr->text_color);
+    }
+    
+    struct SGDisplayResources** link = &g_rm.displays;
+    while (*link != dr) {
+        link = &(*link)->next;
+    }
+    *link = dr->next;
+    free(dr);
     return true;
 }
 
+// Get the window's XftDraw, pointed at its current back buffer
+static XftDraw* bind_window_draw(SGWindow* sgw) {
+    struct SGWindowResources* res = sgw->resources;
+    if (!res || !res->shared->color_allocated) return NULL;
+    if (res->draw && res->drawable == sgw->back_buffer) return res->draw;
+    
+    if (res->draw) {
+        XftDrawChange(res->draw, sgw->back_buffer);
+    } else {
+        res->draw = XftDrawCreate(sgw->display, sgw->back_buffer, 
+                                  DefaultVisual(sgw->display, DefaultScreen(sgw->display)),
+                                  DefaultColormap(sgw->display, DefaultScreen(sgw->display)));
+        if (!res->draw) {
+            sg_log_error("bind_window_draw", "Failed to create XftDraw");
+            return NULL;
+        }
+    }
+    res->drawable = sgw->back_buffer;
+    return res->draw;
+}
+
 //==============================================================================
 // Drawing Functions
 //==============================================================================
 
 /**
- * @brief gradient fill with bounds checking and error handling
+ * @brief Fill the rows [band_y, band_y + band_h) of a gradient spanning [y, y + h)
+ *
+ * Lets a partial repaint reproduce exactly the pixels of a full one.
  */
-static void fill_gradient_rect(Display* display, GC gc, Drawable d, int x, int y, int w, int h, unsigned long c_top, unsigned long c_bottom) {
+static void fill_gradient_band(Display* display, GC gc, Drawable d, int x, int y, int w, int h, 
+                               int band_y, int band_h, unsigned long c_top, unsigned long c_bottom) {
     if (!display || !gc || w <= 0 || h <= 0) return;
     
-    // Extract RGB components with improved bit manipulation
-    const int r1 = (c_top >> 16) & 0xFF;
-    const int g1 = (c_top >> 8)  & 0xFF;
-    const int b1 = c_top & 0xFF;
-    
-    const int r_delta = ((int)((c_bottom >> 16) & 0xFF)) - r1;
-    const int g_delta = ((int)((c_bottom >> 8)  & 0xFF)) - g1;
-    const int b_delta = ((int)(c_bottom & 0xFF)) - b1;
+    // Restrict the band to the gradient itself
+    int first = band_y - y;
+    int last = first + band_h;
+    if (first < 0) first = 0;
+    if (last > h) last = h;
+    if (first >= last) return;
     
     // Optimize for solid colors (no gradient needed)
-    if (r_delta == 0 && g_delta == 0 && b_delta == 0) {
+    if ((c_top & 0xFFFFFF) == (c_bottom & 0xFFFFFF)) {
         XSetForeground(display, gc, c_top);
-        XFillRectangle(display, d, gc, x, y, w, h);
+        XFillRectangle(display, d, gc, x, y + first, w, last - first);
         return;
     }
     
-    // Draw gradient line by line with bounds checking
-    for (int i = 0; i < h; i++) {
-        // Use more precise color interpolation
-        const unsigned char r = (unsigned char)(r1 + (r_delta * i) / h);
-        const unsigned char g = (unsigned char)(g1 + (g_delta * i) / h);
-        const unsigned char b = (unsigned char)(b1 + (b_delta * i) / h);
-        
-        const unsigned long line_color = ((unsigned long)r << 16) | ((unsigned long)g << 8) | b;
-        XSetForeground(display, gc, line_color);
+    // Tile the cached strip across the band in one request
+    Pixmap strip = get_cached_gradient(display, d, h, c_top, c_bottom);
+    if (strip) {
+        XSetTile(display, gc, strip);
+        XSetTSOrigin(display, gc, x, y);
+        XSetFillStyle(display, gc, FillTiled);
+        XFillRectangle(display, d, gc, x, y + first, w, last - first);
+        XSetFillStyle(display, gc, FillSolid);
+        return;
+    }
+    
+    // Draw gradient line by line if the strip could not be rendered
+    for (int i = first; i < last; i++) {
+        XSetForeground(display, gc, gradient_row_color(i, h, c_top, c_bottom));
         XDrawLine(display, d, gc, x, y + i, x + w - 1, y + i);
     }
 }
 
+/**
+ * @brief gradient fill with bounds checking and error handling
+ */
+static void fill_gradient_rect(Display* display, GC gc, Drawable d, int x, int y, int w, int h, unsigned long c_top, unsigned long c_bottom) {
+    fill_gradient_band(display, gc, d, x, y, w, h, y, h, c_top, c_bottom);
+}
+
 /**
  * @brief rounded rectangle with improved bounds checking
  */
@@ -356,352 +922,2241 @@ static bool is_point_in_rect(int px, int py, int rx, int ry, int rw, int rh) {
 }
 
 //==============================================================================
-// Window Management
+// Widget Registry
 //==============================================================================
 
-SGWindow sg_create_window(int width, int height, const char* title) {
-    SGWindow sgw = {0}; // Initialize all fields to 0
+/**
+ * @brief Buttons registered with a window, with a uniform grid over their rects
+ *
+ * Cell c of the grid lists the buttons overlapping it as indices
+ * cell_items[cell_start[c] .. cell_start[c + 1]), in registration order.
+ * The grid is rebuilt lazily after registrations and moves.
+ */
+struct SGWidgetIndex {
+    SGButton** buttons;   // Registration order; later buttons are on top
+    int count;
+    int capacity;
     
-    // Validate input parameters
-    if (width <= 0 || height <= 0) {
-        sg_log_error("sg_create_window", "Invalid window dimensions");
-        exit(EXIT_FAILURE);
+    bool stale;
+    int cell_size;
+    int origin_x, origin_y;
+    int cols, rows;
+    int* cell_start;
+    int* cell_items;
+    
+    SGButton* hovered;    // Button under the pointer
+    SGButton* pressed;    // Button the current press started on
+};
+
+static void widget_index_rebuild(struct SGWidgetIndex* index) {
+    free(index->cell_start);
+    free(index->cell_items);
+    index->cell_start = NULL;
+    index->cell_items = NULL;
+    index->cols = index->rows = 0;
+    index->stale = false;
+    
+    // Bounding box of everything that can be hit
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    for (int i = 0; i < index->count; i++) {
+        const SGButton* b = index->buttons[i];
+        if (b->width <= 0 || b->height <= 0) continue;
+        if (b->x < x0) x0 = b->x;
+        if (b->y < y0) y0 = b->y;
+        if (b->x + b->width > x1) x1 = b->x + b->width;
+        if (b->y + b->height > y1) y1 = b->y + b->height;
     }
+    if (x0 >= x1 || y0 >= y1) return;
     
-    sgw.width = width;
-    sgw.height = height;
+    // Coarsen the grid until its cell count stays proportional to the
+    // number of buttons, however far apart they are
+    int cell = WIDGET_GRID_CELL;
+    long cols, rows;
+    for (;;) {
+        cols = ((long)x1 - x0 + cell - 1) / cell;
+        rows = ((long)y1 - y0 + cell - 1) / cell;
+        if (cols * rows <= 4L * index->count + 64) break;
+        cell *= 2;
+    }
+    
+    const int cells = (int)(cols * rows);
+    index->cell_size = cell;
+    index->origin_x = x0;
+    index->origin_y = y0;
+    index->cols = (int)cols;
+    index->rows = (int)rows;
+    index->cell_start = sg_safe_malloc((size_t)(cells + 1) * sizeof(int));
+    memset(index->cell_start, 0, (size_t)(cells + 1) * sizeof(int));
+    
+    // Count the buttons per cell, then turn the counts into start offsets
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < index->count; i++) {
+            const SGButton* b = index->buttons[i];
+            if (b->width <= 0 || b->height <= 0) continue;
+            
+            const int cx0 = (b->x - x0) / cell;
+            const int cy0 = (b->y - y0) / cell;
+            const int cx1 = (b->x + b->width - 1 - x0) / cell;
+            const int cy1 = (b->y + b->height - 1 - y0) / cell;
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) {
+                    const int c = cy * index->cols + cx;
+                    if (pass == 0) {
+                        index->cell_start[c + 1]++;
+                    } else {
+                        index->cell_items[index->cell_start[c]++] = i;
+                    }
+                }
+            }
+        }
+        
+        if (pass == 0) {
+            for (int c = 0; c < cells; c++) {
+                index->cell_start[c + 1] += index->cell_start[c];
+            }
+            index->cell_items = sg_safe_malloc((size_t)(index->cell_start[cells] + 1) * sizeof(int));
+        }
+    }
+    
+    // Filling advanced each start to the next cell's; shift them back
+    memmove(index->cell_start + 1, index->cell_start, (size_t)cells * sizeof(int));
+    index->cell_start[0] = 0;
+}
 
-    // Open X11 display
-    sgw.display = XOpenDisplay(NULL);
-    if (!sgw.display) {
-        sg_log_error("sg_create_window", "Cannot open X11 display");
-        exit(EXIT_FAILURE);
+static void free_widget_index(SGWindow* sgw) {
+    struct SGWidgetIndex* index = sgw->widgets;
+    if (!index) return;
+    
+    for (int i = 0; i < index->count; i++) {
+        index->buttons[i]->registered = false;
     }
+    free(index->buttons);
+    free(index->cell_start);
+    free(index->cell_items);
+    free(index);
+    sgw->widgets = NULL;
+}
 
-    int screen = DefaultScreen(sgw.display);
-    Window root = RootWindow(sgw.display, screen);
+void sg_register_button(SGWindow* sgw, SGButton* button) {
+    if (!sgw || !button || button->registered) return;
+    
+    if (!sgw->widgets) {
+        sgw->widgets = sg_safe_malloc(sizeof(*sgw->widgets));
+        memset(sgw->widgets, 0, sizeof(*sgw->widgets));
+    }
+    
+    struct SGWidgetIndex* index = sgw->widgets;
+    if (index->count == index->capacity) {
+        index->capacity = index->capacity ? index->capacity * 2 : 16;
+        index->buttons = sg_safe_realloc(index->buttons, (size_t)index->capacity * sizeof(SGButton*));
+    }
+    index->buttons[index->count++] = button;
+    index->stale = true;
+    button->registered = true;
+    damage_rect(sgw, button_bounds(button));
+}
+
+void sg_unregister_button(SGWindow* sgw, SGButton* button) {
+    if (!sgw || !sgw->widgets || !button || !button->registered) return;
+    
+    struct SGWidgetIndex* index = sgw->widgets;
+    for (int i = 0; i < index->count; i++) {
+        if (index->buttons[i] != button) continue;
+        
+        // Keep the registration order, it decides which button is on top
+        memmove(&index->buttons[i], &index->buttons[i + 1], 
+                (size_t)(index->count - i - 1) * sizeof(SGButton*));
+        index->count--;
+        index->stale = true;
+        break;
+    }
+    
+    if (index->hovered == button) index->hovered = NULL;
+    if (index->pressed == button) index->pressed = NULL;
+    button->registered = false;
+    damage_rect(sgw, button_bounds(button));
+}
+
+void sg_widgets_moved(SGWindow* sgw) {
+    if (!sgw || !sgw->widgets) return;
+    sgw->widgets->stale = true;
+}
+
+// Topmost registered button containing the point, or NULL
+SGButton* sg_hit_test(SGWindow* sgw, int x, int y) {
+    struct SGWidgetIndex* index = sgw ? sgw->widgets : NULL;
+    if (!index) return NULL;
+    
+    if (index->stale) widget_index_rebuild(index);
+    if (index->cols == 0 || x < index->origin_x || y < index->origin_y) return NULL;
+    
+    const int cx = (x - index->origin_x) / index->cell_size;
+    const int cy = (y - index->origin_y) / index->cell_size;
+    if (cx >= index->cols || cy >= index->rows) return NULL;
+    
+    const int c = cy * index->cols + cx;
+    for (int i = index->cell_start[c + 1] - 1; i >= index->cell_start[c]; i--) {
+        SGButton* b = index->buttons[index->cell_items[i]];
+        if (is_point_in_rect(x, y, b->x, b->y, b->width, b->height)) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+// Hover transitions repaint the button and tell its owner
+static void set_button_hovered(SGWindow* sgw, SGButton* button, bool hovered) {
+    if (button->hovered == hovered) return;
+    
+    button->hovered = hovered;
+    damage_rect(sgw, button_bounds(button));
+    if (button->on_hover) {
+        button->on_hover(button, hovered, button->user_data);
+    }
+}
+
+// Move the registry's hover to 'hit' as a leave followed by an enter
+static void update_registry_hover(SGWindow* sgw, SGButton* hit) {
+    struct SGWidgetIndex* index = sgw->widgets;
+    if (!index || index->hovered == hit) return;
+    
+    SGButton* left = index->hovered;
+    index->hovered = hit;
+    if (left) set_button_hovered(sgw, left, false);
+    if (hit) set_button_hovered(sgw, hit, true);
+}
+
+//==============================================================================
+// Button Cache
+//==============================================================================
+
+// Free every cached button resource of the display
+static void cleanup_button_cache(struct SGDisplayResources* dr) {
+    Display* display = dr->display;
+    
+    for (int i = 0; i < MAX_CACHED_MASKS; i++) {
+        if (dr->mask_cache[i].mask) {
+            XFreePixmap(display, dr->mask_cache[i].mask);
+        }
+    }
+    for (int i = 0; i < MAX_CACHED_FACES; i++) {
+        if (dr->face_cache[i].face) {
+            XFreePixmap(display, dr->face_cache[i].face);
+        }
+        free(dr->face_cache[i].text);
+    }
+    memset(dr->mask_cache, 0, sizeof(dr->mask_cache));
+    memset(dr->face_cache, 0, sizeof(dr->face_cache));
+    
+    if (dr->face_draw) {
+        XftDrawDestroy(dr->face_draw);
+        dr->face_draw = NULL;
+    }
+    if (dr->mask_gc) {
+        XFreeGC(display, dr->mask_gc);
+        dr->mask_gc = NULL;
+    }
+    if (dr->face_gc) {
+        XFreeGC(display, dr->face_gc);
+        dr->face_gc = NULL;
+    }
+}
+
+// Render a button mask of the given kind; the bitmap is (w + SHADOW_OFFSET) x
+// (h + SHADOW_OFFSET) except for MASK_SHAPE, which is w x h
+static Pixmap create_button_mask(struct SGDisplayResources* dr, Drawable d, int w, int h, int r, int kind) {
+    Display* display = dr->display;
+    const int mw = (kind == MASK_SHAPE) ? w : w + SHADOW_OFFSET;
+    const int mh = (kind == MASK_SHAPE) ? h : h + SHADOW_OFFSET;
+    
+    Pixmap mask = XCreatePixmap(display, d, mw, mh, 1);
+    if (!mask) return None;
+    
+    // A single GC serves every 1-bit mask
+    if (!dr->mask_gc) {
+        dr->mask_gc = XCreateGC(display, mask, 0, NULL);
+        if (!dr->mask_gc) {
+            XFreePixmap(display, mask);
+            return None;
+        }
+    }
+    
+    XSetForeground(display, dr->mask_gc, 0);
+    XFillRectangle(display, mask, dr->mask_gc, 0, 0, mw, mh);
+    
+    switch (kind) {
+        case MASK_RAISED:
+            fill_rounded_rect(display, mask, dr->mask_gc, SHADOW_OFFSET, SHADOW_OFFSET, w, h, r, 1);
+            fill_rounded_rect(display, mask, dr->mask_gc, 0, 0, w, h, r, 1);
+            draw_rounded_rect(display, mask, dr->mask_gc, 0, 0, w - 1, h - 1, r, 1);
+            break;
+        case MASK_PRESSED:
+            fill_rounded_rect(display, mask, dr->mask_gc, 0, SHADOW_OFFSET / 2, w, h, r, 1);
+            draw_rounded_rect(display, mask, dr->mask_gc, 0, SHADOW_OFFSET / 2, w - 1, h - 1, r, 1);
+            break;
+        default:
+            fill_rounded_rect(display, mask, dr->mask_gc, 0, 0, w, h, r, 1);
+            break;
+    }
+    return mask;
+}
+
+// Get a button mask, rendering it on a miss
+static Pixmap get_cached_mask(struct SGDisplayResources* dr, Drawable d, int w, int h, int r, int kind) {
+    dr->button_clock++;
+    
+    int slot = -1;
+    for (int i = 0; i < MAX_CACHED_MASKS; i++) {
+        MaskCacheEntry* entry = &dr->mask_cache[i];
+        if (entry->mask && entry->width == w && entry->height == h && 
+            entry->radius == r && entry->kind == kind) {
+            entry->last_used = dr->button_clock;
+            return entry->mask;
+        }
+        
+        // Remember an empty slot, or else the least recently used one
+        if (slot == -1 || (dr->mask_cache[slot].mask && 
+            (!entry->mask || entry->last_used < dr->mask_cache[slot].last_used))) {
+            slot = i;
+        }
+    }
+    
+    MaskCacheEntry* entry = &dr->mask_cache[slot];
+    if (entry->mask) {
+        XFreePixmap(dr->display, entry->mask);
+        entry->mask = None;
+    }
+    
+    Pixmap mask = create_button_mask(dr, d, w, h, r, kind);
+    if (!mask) return None;
+    
+    *entry = (MaskCacheEntry){ mask, w, h, r, kind, dr->button_clock };
+    return mask;
+}
+
+// Hash of everything a button face depends on
+static unsigned long hash_button_face(int w, int h, int state, const char* text) {
+    unsigned long hash = 2166136261UL;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash = (hash ^ *p) * 16777619UL;
+    }
+    hash = (hash ^ (unsigned long)w) * 16777619UL;
+    hash = (hash ^ (unsigned long)h) * 16777619UL;
+    return (hash ^ (unsigned long)state) * 16777619UL;
+}
+
+// Render a button in one state: shadow, gradient face, border and text,
+// laid out exactly as drawn at the button's position
+static Pixmap create_button_face(SGWindow* sgw, const SGButton* button, int state) {
+    Display* display = sgw->display;
+    const int w = button->width;
+    const int h = button->height;
+    const int r = BUTTON_RADIUS;
+    
+    unsigned long top_color, bottom_color;
+    int draw_y = 0;
+    
+    // Determine button appearance based on state
+    switch (state) {
+        case FACE_PRESSED:
+            top_color = BTN_PRESSED_TOP;
+            bottom_color = BTN_PRESSED_BOTTOM;
+            draw_y += SHADOW_OFFSET / 2; // Inset effect
+            break;
+        case FACE_HOVER:
+            top_color = BTN_HOVER_TOP;
+            bottom_color = BTN_HOVER_BOTTOM;
+            break;
+        default:
+            top_color = BTN_IDLE_TOP;
+            bottom_color = BTN_IDLE_BOTTOM;
+            break;
+    }
+    
+    struct SGDisplayResources* dr = sgw->resources->shared;
+    Pixmap shape = get_cached_mask(dr, sgw->back_buffer, w, h, r, MASK_SHAPE);
+    if (!shape) return None;
+    
+    Pixmap face = XCreatePixmap(display, sgw->back_buffer, w + SHADOW_OFFSET, h + SHADOW_OFFSET, 
+                                DefaultDepth(display, DefaultScreen(display)));
+    if (!face) return None;
+    
+    if (!dr->face_gc) {
+        dr->face_gc = XCreateGC(display, face, 0, NULL);
+        if (!dr->face_gc) {
+            XFreePixmap(display, face);
+            return None;
+        }
+    }
+    GC gc = dr->face_gc;
+    
+    // Draw drop shadow for non-pressed states
+    if (state != FACE_PRESSED) {
+        fill_rounded_rect(display, face, gc, SHADOW_OFFSET, SHADOW_OFFSET, w, h, r, SHADOW_COLOR);
+    }
+    
+    // Draw gradient background clipped to the rounded shape
+    XSetClipMask(display, gc, shape);
+    XSetClipOrigin(display, gc, 0, draw_y);
+    fill_gradient_rect(display, gc, face, 0, draw_y, w, h, top_color, bottom_color);
+    XSetClipMask(display, gc, None);
+    
+    // Draw border
+    draw_rounded_rect(display, face, gc, 0, draw_y, w - 1, h - 1, r, BORDER_COLOR);
+    
+    // Draw text with enhanced font management
+    XftFont* font = get_cached_font(display, "sans:bold", 12);
+    if (font) {
+        if (dr->face_draw) {
+            XftDrawChange(dr->face_draw, face);
+        } else {
+            dr->face_draw = XftDrawCreate(display, face, 
+                                           DefaultVisual(display, DefaultScreen(display)),
+                                           DefaultColormap(display, DefaultScreen(display)));
+        }
+        
+        if (dr->face_draw) {
+            const struct SGGlyphRun* run = get_glyph_run(display, font, button->text);
+
+            const int text_x = (w - run->extents.width) / 2;
+            const int text_y = draw_y + (h - run->extents.height) / 2 + font->ascent;
+
+            XftDrawGlyphs(dr->face_draw, &dr->text_color, font, text_x, text_y, 
+                          run->glyphs, run->glyph_count);
+        }
+    }
+    
+    return face;
+}
+
+// Get the pre-rendered face of a button, rendering it on a miss
+static Pixmap get_cached_face(SGWindow* sgw, const SGButton* button, int state) {
+    struct SGDisplayResources* dr = sgw->resources->shared;
+    const unsigned long hash = hash_button_face(button->width, button->height, state, button->text);
+    dr->button_clock++;
+    
+    int slot = -1;
+    for (int i = 0; i < MAX_CACHED_FACES; i++) {
+        FaceCacheEntry* entry = &dr->face_cache[i];
+        if (entry->face && entry->hash == hash && entry->width == button->width &&
+            entry->height == button->height && entry->state == state && 
+            strcmp(entry->text, button->text) == 0) {
+            entry->last_used = dr->button_clock;
+            return entry->face;
+        }
+        
+        // Remember an empty slot, or else the least recently used one
+        if (slot == -1 || (dr->face_cache[slot].face && 
+            (!entry->face || entry->last_used < dr->face_cache[slot].last_used))) {
+            slot = i;
+        }
+    }
+    
+    FaceCacheEntry* entry = &dr->face_cache[slot];
+    if (entry->face) {
+        XFreePixmap(sgw->display, entry->face);
+        entry->face = None;
+    }
+    free(entry->text);
+    entry->text = NULL;
+    
+    Pixmap face = create_button_face(sgw, button, state);
+    if (!face) return None;
+    
+    *entry = (FaceCacheEntry){ face, button->width, button->height, state, hash, 
+                               sg_safe_strdup(button->text), dr->button_clock };
+    return face;
+}
+
+//==============================================================================
+// Raster Backend
+//==============================================================================
+
+/**
+ * @brief Client-side back buffer for SG_BACKEND_IMAGE
+ *
+ * Frames are rasterized into 'pixels' and uploaded once per flush, either
+ * straight from shared memory or through an ARGB32 pixmap composited with
+ * XRender when the server cannot share memory with us.
+ */
+struct SGRaster {
+    uint32_t* pixels;   // 0xAARRGGBB, 'stride' pixels per row
+    int width, height, stride;
+    XImage* image;
+    
+    // MIT-SHM upload
+    bool use_shm;
+    bool shm_busy;      // The server may still be reading the last frame
+    XShmSegmentInfo shm;
+    
+    // XRender upload
+    Pixmap upload;
+    GC upload_gc;
+    Picture upload_picture;
+    Picture window_picture;
+};
+
+static bool g_x_error_trapped = false;
+
+static int trap_x_error(Display* display, XErrorEvent* event) {
+    (void)display;
+    (void)event;
+    g_x_error_trapped = true;
+    return 0;
+}
+
+// Shared memory only works with a local server whose visual stores pixels
+// exactly like our buffer does
+static bool raster_can_use_shm(Display* display, const Visual* visual, int depth) {
+    return XShmQueryExtension(display) && visual->class == TrueColor &&
+           (depth == 24 || depth == 32) && visual->red_mask == 0xFF0000 &&
+           visual->green_mask == 0x00FF00 && visual->blue_mask == 0x0000FF;
+}
+
+static bool raster_attach_shm(struct SGRaster* raster, Display* display, Visual* visual, int depth) {
+    raster->image = XShmCreateImage(display, visual, depth, ZPixmap, NULL, &raster->shm, 
+                                    raster->width, raster->height);
+    if (!raster->image) return false;
+    if (raster->image->bits_per_pixel != 32) {
+        XDestroyImage(raster->image);
+        raster->image = NULL;
+        return false;
+    }
+    
+    raster->shm.shmid = shmget(IPC_PRIVATE, (size_t)raster->image->bytes_per_line * raster->height, 
+                               IPC_CREAT | 0600);
+    if (raster->shm.shmid < 0) {
+        XDestroyImage(raster->image);
+        raster->image = NULL;
+        return false;
+    }
+    
+    raster->shm.shmaddr = raster->image->data = shmat(raster->shm.shmid, NULL, 0);
+    raster->shm.readOnly = False;
+    
+    // A remote server fails the attach asynchronously, so wait for the verdict
+    bool attached = false;
+    if (raster->shm.shmaddr != (char*)-1) {
+        g_x_error_trapped = false;
+        int (*old_handler)(Display*, XErrorEvent*) = XSetErrorHandler(trap_x_error);
+        XShmAttach(display, &raster->shm);
+        XSync(display, False);
+        XSetErrorHandler(old_handler);
+        attached = !g_x_error_trapped;
+    }
+    
+    // The segment goes away with its last user, even if we crash
+    shmctl(raster->shm.shmid, IPC_RMID, NULL);
+    
+    if (!attached) {
+        if (raster->shm.shmaddr != (char*)-1) {
+            shmdt(raster->shm.shmaddr);
+        }
+        raster->image->data = NULL;
+        XDestroyImage(raster->image);
+        raster->image = NULL;
+        return false;
+    }
+    
+    raster->pixels = (uint32_t*)raster->image->data;
+    raster->stride = raster->image->bytes_per_line / 4;
+    raster->use_shm = true;
+    return true;
+}
+
+static bool raster_attach_render(struct SGRaster* raster, Display* display, Window window, Visual* visual) {
+    int event_base, error_base;
+    if (!XRenderQueryExtension(display, &event_base, &error_base)) return false;
+    
+    XRenderPictFormat* argb = XRenderFindStandardFormat(display, PictStandardARGB32);
+    XRenderPictFormat* window_format = XRenderFindVisualFormat(display, visual);
+    if (!argb || !window_format) return false;
+    
+    raster->pixels = malloc((size_t)raster->width * raster->height * sizeof(uint32_t));
+    if (!raster->pixels) return false;
+    raster->stride = raster->width;
+    
+    raster->image = XCreateImage(display, visual, 32, ZPixmap, 0, (char*)raster->pixels, 
+                                 raster->width, raster->height, 32, raster->width * 4);
+    if (!raster->image) {
+        free(raster->pixels);
+        raster->pixels = NULL;
+        return false;
+    }
+    
+    // The buffer holds native-endian words; Xlib swaps them if the server differs
+    const uint32_t probe = 1;
+    raster->image->byte_order = (*(const unsigned char*)&probe == 1) ? LSBFirst : MSBFirst;
+    
+    raster->upload = XCreatePixmap(display, window, raster->width, raster->height, 32);
+    raster->upload_gc = XCreateGC(display, raster->upload, 0, NULL);
+    raster->upload_picture = XRenderCreatePicture(display, raster->upload, argb, 0, NULL);
+    raster->window_picture = XRenderCreatePicture(display, window, window_format, 0, NULL);
+    return true;
+}
+
+static void raster_destroy(Display* display, struct SGRaster* raster) {
+    if (!raster) return;
+    
+    if (raster->use_shm) {
+        XShmDetach(display, &raster->shm);
+        XSync(display, False);
+        shmdt(raster->shm.shmaddr);
+        raster->image->data = NULL;
+        XDestroyImage(raster->image);
+    } else {
+        if (raster->window_picture) XRenderFreePicture(display, raster->window_picture);
+        if (raster->upload_picture) XRenderFreePicture(display, raster->upload_picture);
+        if (raster->upload_gc) XFreeGC(display, raster->upload_gc);
+        if (raster->upload) XFreePixmap(display, raster->upload);
+        if (raster->image) XDestroyImage(raster->image); // Also frees 'pixels'
+    }
+    free(raster);
+}
+
+// Create a client-side back buffer, or NULL if the server offers no way to
+// upload one
+static struct SGRaster* raster_create(Display* display, Window window, int width, int height) {
+    const int screen = DefaultScreen(display);
+    Visual* visual = DefaultVisual(display, screen);
+    const int depth = DefaultDepth(display, screen);
+    
+    struct SGRaster* raster = calloc(1, sizeof(*raster));
+    if (!raster) return NULL;
+    raster->width = width;
+    raster->height = height;
+    
+    if (raster_can_use_shm(display, visual, depth) && raster_attach_shm(raster, display, visual, depth)) {
+        return raster;
+    }
+    if (raster_attach_render(raster, display, window, visual)) {
+        return raster;
+    }
+    
+    free(raster);
+    return NULL;
+}
+
+// Wait until the server is done with the previous upload before drawing over it
+static void raster_begin(Display* display, struct SGRaster* raster) {
+    if (raster->shm_busy) {
+        XSync(display, False);
+        raster->shm_busy = false;
+    }
+}
+
+static void raster_present(SGWindow* sgw, const SGRect* r) {
+    struct SGRaster* raster = sgw->raster;
+    
+    if (raster->use_shm) {
+        XShmPutImage(sgw->display, sgw->window, sgw->gc, raster->image, 
+                     r->x, r->y, r->x, r->y, r->width, r->height, False);
+        raster->shm_busy = true;
+        return;
+    }
+    
+    XPutImage(sgw->display, raster->upload, raster->upload_gc, raster->image, 
+              r->x, r->y, r->x, r->y, r->width, r->height);
+    XRenderComposite(sgw->display, PictOpSrc, raster->upload_picture, None, raster->window_picture, 
+                     r->x, r->y, 0, 0, r->x, r->y, r->width, r->height);
+}
+
+// Area of the raster this frame may touch
+static bool raster_clip(const SGWindow* sgw, int* x0, int* y0, int* x1, int* y1) {
+    *x0 = (sgw->frame.x > 0) ? sgw->frame.x : 0;
+    *y0 = (sgw->frame.y > 0) ? sgw->frame.y : 0;
+    *x1 = sgw->frame.x + sgw->frame.width;
+    *y1 = sgw->frame.y + sgw->frame.height;
+    if (*x1 > sgw->raster->width) *x1 = sgw->raster->width;
+    if (*y1 > sgw->raster->height) *y1 = sgw->raster->height;
+    return *x0 < *x1 && *y0 < *y1;
+}
+
+// Straight store loop, left simple so the compiler vectorizes it
+static void raster_fill_span(uint32_t* row, int count, uint32_t color) {
+    for (int i = 0; i < count; i++) {
+        row[i] = color;
+    }
+}
+
+// Blend 'color' over an opaque pixel with 'coverage' in [0, 255]
+static inline uint32_t raster_blend(uint32_t dst, uint32_t color, unsigned int coverage) {
+    if (coverage >= 255) return color;
+    
+    const unsigned int inverse = 255 - coverage;
+    const uint32_t rb = ((color & 0xFF00FF) * coverage + (dst & 0xFF00FF) * inverse + 0x800080) >> 8;
+    const uint32_t g = ((color & 0x00FF00) * coverage + (dst & 0x00FF00) * inverse + 0x008000) >> 8;
+    return 0xFF000000 | (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// Signed distance from (px, py) to the edge of a w x h rectangle with
+// corner radius r, negative inside
+static float rounded_rect_distance(float px, float py, float w, float h, float r) {
+    const float qx = fabsf(px - w * 0.5f) - (w * 0.5f - r);
+    const float qy = fabsf(py - h * 0.5f) - (h * 0.5f - r);
+    const float ox = (qx > 0.0f) ? qx : 0.0f;
+    const float oy = (qy > 0.0f) ? qy : 0.0f;
+    const float inside = (qx > qy) ? qx : qy;
+    return sqrtf(ox * ox + oy * oy) + ((inside < 0.0f) ? inside : 0.0f) - r;
+}
+
+// Pixel coverage of the area where the signed distance is negative
+static inline float raster_coverage(float distance) {
+    const float c = 0.5f - distance;
+    return (c < 0.0f) ? 0.0f : (c > 1.0f) ? 1.0f : c;
+}
+
+/**
+ * @brief Antialiased rounded rectangle, filled with a vertical gradient or
+ *        stroked one pixel wide along its inside edge
+ *
+ * Only pixels near the corners and edges need a distance evaluation; the
+ * rest of every row is a plain span.
+ */
+static void raster_rounded_rect(SGWindow* sgw, int x, int y, int w, int h, int r, 
+                                unsigned long c_top, unsigned long c_bottom, bool stroke) {
+    int cx0, cy0, cx1, cy1;
+    if (w <= 0 || h <= 0 || !raster_clip(sgw, &cx0, &cy0, &cx1, &cy1)) return;
+    
+    // Clamp radius to valid range
+    r = (r < 0) ? 0 : r;
+    if (r * 2 > w) r = w / 2;
+    if (r * 2 > h) r = h / 2;
+    
+    const int first = (cy0 > y) ? cy0 - y : 0;
+    const int last = (cy1 < y + h) ? cy1 - y : h;
+    const int left = (cx0 > x) ? cx0 - x : 0;
+    const int right = (cx1 < x + w) ? cx1 - x : w;
+    
+    struct SGRaster* raster = sgw->raster;
+    for (int i = first; i < last; i++) {
+        uint32_t* row = raster->pixels + (size_t)(y + i) * raster->stride + x;
+        const uint32_t color = 0xFF000000 | (uint32_t)gradient_row_color(i, h, c_top, c_bottom);
+        
+        // Rows along the rounded corners need per-pixel coverage further in
+        int edge = (i < r || i >= h - r) ? r : 1;
+        if (edge * 2 > w) edge = (w + 1) / 2;
+        
+        for (int j = left; j < right; j++) {
+            if (j >= edge && j < w - edge) {
+                // Between the edges a fill is solid and a stroke only covers
+                // the top and bottom rows
+                const int end = (w - edge < right) ? w - edge : right;
+                if (!stroke || i == 0 || i == h - 1) {
+                    raster_fill_span(row + j, end - j, color);
+                }
+                j = end - 1;
+                continue;
+            }
+            
+            const float d = rounded_rect_distance(j + 0.5f, i + 0.5f, (float)w, (float)h, (float)r);
+            float coverage = raster_coverage(d);
+            if (stroke) {
+                coverage -= raster_coverage(d + 1.0f);
+            }
+            if (coverage > 0.0f) {
+                row[j] = raster_blend(row[j], color, (unsigned int)(coverage * 255.0f + 0.5f));
+            }
+        }
+    }
+}
+
+// Fill the rows [band_y, band_y + band_h) of a gradient spanning [y, y + h)
+static void raster_fill_gradient_band(SGWindow* sgw, int x, int y, int w, int h, 
+                                      int band_y, int band_h, unsigned long c_top, unsigned long c_bottom) {
+    int cx0, cy0, cx1, cy1;
+    if (w <= 0 || h <= 0 || !raster_clip(sgw, &cx0, &cy0, &cx1, &cy1)) return;
+    
+    if (cx0 < x) cx0 = x;
+    if (cx1 > x + w) cx1 = x + w;
+    if (cy0 < band_y) cy0 = band_y;
+    if (cy1 > band_y + band_h) cy1 = band_y + band_h;
+    if (cy0 < y) cy0 = y;
+    if (cy1 > y + h) cy1 = y + h;
+    if (cx0 >= cx1) return;
+    
+    struct SGRaster* raster = sgw->raster;
+    for (int py = cy0; py < cy1; py++) {
+        const uint32_t color = 0xFF000000 | (uint32_t)gradient_row_color(py - y, h, c_top, c_bottom);
+        raster_fill_span(raster->pixels + (size_t)py * raster->stride + cx0, cx1 - cx0, color);
+    }
+}
+
+// Draw a glyph run with its baseline at (x, y), rasterizing glyphs with the
+// FreeType face behind the Xft font
+static void raster_draw_glyphs(SGWindow* sgw, XftFont* font, int x, int y, 
+                               const struct SGGlyphRun* run, unsigned long color) {
+    int cx0, cy0, cx1, cy1;
+    if (!raster_clip(sgw, &cx0, &cy0, &cx1, &cy1)) return;
+    
+    FT_Face face = XftLockFace(font);
+    if (!face) return;
+    
+    struct SGRaster* raster = sgw->raster;
+    const uint32_t argb = 0xFF000000 | (uint32_t)color;
+    int pen_x = x;
+    
+    for (int i = 0; i < run->glyph_count; i++) {
+        if (FT_Load_Glyph(face, run->glyphs[i], FT_LOAD_DEFAULT) != 0 ||
+            FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL) != 0) {
+            continue;
+        }
+        
+        const FT_GlyphSlot slot = face->glyph;
+        const FT_Bitmap* bitmap = &slot->bitmap;
+        const int gx = pen_x + slot->bitmap_left;
+        const int gy = y - slot->bitmap_top;
+        
+        for (unsigned int row = 0; row < bitmap->rows; row++) {
+            const int py = gy + (int)row;
+            if (py < cy0 || py >= cy1) continue;
+            
+            const unsigned char* src = bitmap->buffer + (long)row * bitmap->pitch;
+            uint32_t* dst = raster->pixels + (size_t)py * raster->stride;
+            for (unsigned int col = 0; col < bitmap->width; col++) {
+                const int px = gx + (int)col;
+                if (px < cx0 || px >= cx1) continue;
+                
+                unsigned int coverage;
+                if (bitmap->pixel_mode == FT_PIXEL_MODE_MONO) {
+                    coverage = (src[col >> 3] & (0x80 >> (col & 7))) ? 255 : 0;
+                } else {
+                    coverage = src[col];
+                }
+                if (coverage) {
+                    dst[px] = raster_blend(dst[px], argb, coverage);
+                }
+            }
+        }
+        
+        pen_x += (int)((slot->advance.x + 32) >> 6);
+    }
+    
+    XftUnlockFace(font);
+}
+
+// Button drawing for SG_BACKEND_IMAGE, matching the Xlib look with
+// antialiased edges
+static void raster_draw_button(SGWindow* sgw, SGButton* button) {
+    const int x = button->x;
+    const int y = button->y;
+    const int w = button->width;
+    const int h = button->height;
+    const int r = BUTTON_RADIUS;
+    
+    unsigned long top_color, bottom_color;
+    int draw_y = y;
+
+    // Determine button appearance based on state
+    if (button->pressed) {
+        top_color = BTN_PRESSED_TOP;
+        bottom_color = BTN_PRESSED_BOTTOM;
+        draw_y += SHADOW_OFFSET / 2; // Inset effect
+    } else {
+        if (button->hovered) {
+            top_color = BTN_HOVER_TOP;
+            bottom_color = BTN_HOVER_BOTTOM;
+        } else {
+            top_color = BTN_IDLE_TOP;
+            bottom_color = BTN_IDLE_BOTTOM;
+        }
+        // Draw drop shadow for non-pressed states
+        raster_rounded_rect(sgw, x + SHADOW_OFFSET, y + SHADOW_OFFSET, w, h, r, 
+                            SHADOW_COLOR, SHADOW_COLOR, false);
+    }
+    
+    raster_rounded_rect(sgw, x, draw_y, w, h, r, top_color, bottom_color, false);
+    raster_rounded_rect(sgw, x, draw_y, w, h, r, BORDER_COLOR, BORDER_COLOR, true);
+    
+    XftFont* font = resolve_font(sgw->display, "sans:bold", 12, &button->font_handle);
+    if (font) {
+        const struct SGGlyphRun* run = resolve_glyph_run(sgw->display, font, button->text, 
+                                                         &button->text_cache);
+
+        const int text_x = x + (w - run->extents.width) / 2;
+        const int text_y = draw_y + (h - run->extents.height) / 2 + font->ascent;
+        raster_draw_glyphs(sgw, font, text_x, text_y, run, FG_COLOR);
+    }
+}
+
+//==============================================================================
+// Window Management
+//==============================================================================
+
+// The retained scene is drawn by the event loop and freed with its window
+static void free_scene(SGWindow* sgw);
+static void scene_collect_changes(SGWindow* sgw);
+static void scene_emit(SGWindow* sgw);
+
+// Back buffer of either backend
+static bool has_back_buffer(const SGWindow* sgw) {
+    return sgw->back_buffer || sgw->raster;
+}
+
+// Back buffer extent for a resized window, with room for a drag to keep growing
+static int back_buffer_extent(int size) {
+    const int padded = size + size / 4;
+    return (padded + BUFFER_GROW_STEP - 1) / BUFFER_GROW_STEP * BUFFER_GROW_STEP;
+}
+
+// A back buffer serves the window while it is large enough and not much
+// more than twice as large; the gap keeps a drag hovering around a size
+// from reallocating on every step
+static bool back_buffer_fits(const SGWindow* sgw) {
+    return sgw->width <= sgw->buffer_width && sgw->height <= sgw->buffer_height &&
+           sgw->buffer_width <= 2 * sgw->width + BUFFER_GROW_STEP &&
+           sgw->buffer_height <= 2 * sgw->height + BUFFER_GROW_STEP;
+}
+
+// Create a back buffer of the window's buffer size, falling back to a
+// server-side pixmap if the client-side one cannot be set up
+static bool create_back_buffer(SGWindow* sgw) {
+    if (sgw->backend == SG_BACKEND_IMAGE) {
+        sgw->raster = raster_create(sgw->display, sgw->window, sgw->buffer_width, sgw->buffer_height);
+        if (sgw->raster) return true;
+        
+        sg_log_error("create_back_buffer", "Client-side rendering unavailable, using Xlib drawing");
+        sgw->backend = SG_BACKEND_XLIB;
+    }
+    
+    sgw->back_buffer = XCreatePixmap(sgw->display, sgw->window, sgw->buffer_width, sgw->buffer_height, 
+                                     DefaultDepth(sgw->display, DefaultScreen(sgw->display)));
+    return sgw->back_buffer != 0;
+}
+
+static void destroy_back_buffer(SGWindow* sgw) {
+    // A new pixmap may reuse the old ID, so the draw must not trust it
+    if (sgw->resources) {
+        sgw->resources->drawable = None;
+    }
+    if (sgw->raster) {
+        raster_destroy(sgw->display, sgw->raster);
+        sgw->raster = NULL;
+    }
+    if (sgw->back_buffer) {
+        XFreePixmap(sgw->display, sgw->back_buffer);
+        sgw->back_buffer = 0;
+    }
+}
+
+SGWindow sg_create_window(int width, int height, const char* title) {
+    return sg_create_window_with_backend(width, height, title, SG_BACKEND_AUTO);
+}
+
+// Create a window on an open connection; 'own_display' says whether a
+// failure has to close it
+static SGWindow create_window_on(Display* display, bool own_display, int width, int height,
+                                 const char* title, SGBackend backend) {
+    SGWindow sgw = {0}; // Initialize all fields to 0
+    
+    sgw.width = width;
+    sgw.height = height;
+    sgw.buffer_width = width;
+    sgw.buffer_height = height;
+    sgw.display = display;
+
+    int screen = DefaultScreen(sgw.display);
+    Window root = RootWindow(sgw.display, screen);
 
     // Create window with error checking
     sgw.window = XCreateSimpleWindow(sgw.display, root, 10, 10, width, height, 
                                     0, 0, BG_COLOR_BOTTOM);
     if (!sgw.window) {
         sg_log_error("sg_create_window", "Failed to create window");
-        XCloseDisplay(sgw.display);
+        if (own_display) XCloseDisplay(sgw.display);
+        exit(EXIT_FAILURE);
+    }
+
+    // Set window title safely
+    if (title) {
+        XStoreName(sgw.display, sgw.window, title);
+    }
+
+    // Select input events
+    XSelectInput(sgw.display, sgw.window, 
+                ExposureMask | KeyPressMask | ButtonPressMask | ButtonReleaseMask | 
+                PointerMotionMask | LeaveWindowMask | StructureNotifyMask);
+    
+    // Create graphics context
+    sgw.gc = XCreateGC(sgw.display, sgw.window, 0, NULL);
+    if (!sgw.gc) {
+        sg_log_error("sg_create_window", "Failed to create graphics context");
+        XDestroyWindow(sgw.display, sgw.window);
+        if (own_display) XCloseDisplay(sgw.display);
+        exit(EXIT_FAILURE);
+    }
+    
+    // Create back buffer for double buffering; automatic selection prefers
+    // client-side rendering and quietly settles for Xlib without it
+    sgw.backend = (backend == SG_BACKEND_XLIB) ? SG_BACKEND_XLIB : SG_BACKEND_IMAGE;
+    if (backend == SG_BACKEND_AUTO) {
+        sgw.raster = raster_create(sgw.display, sgw.window, width, height);
+        if (!sgw.raster) sgw.backend = SG_BACKEND_XLIB;
+    }
+    if (!sgw.raster && !create_back_buffer(&sgw)) {
+        sg_log_error("sg_create_window", "Failed to create back buffer");
+        XFreeGC(sgw.display, sgw.gc);
+        XDestroyWindow(sgw.display, sgw.window);
+        if (own_display) XCloseDisplay(sgw.display);
+        exit(EXIT_FAILURE);
+    }
+
+    // Text color and caches are shared with other windows on the connection
+    sgw.resources = sg_safe_malloc(sizeof(*sgw.resources));
+    memset(sgw.resources, 0, sizeof(*sgw.resources));
+    sgw.resources->shared = acquire_display_resources(sgw.display);
+
+    // Map window and set up close protocol
+    XMapWindow(sgw.display, sgw.window);
+    
+    Atom wm_delete_window = XInternAtom(sgw.display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(sgw.display, sgw.window, &wm_delete_window, 1);
+
+    // The first frame paints everything
+    sg_invalidate_window(&sgw);
+
+    return sgw;
+}
+
+SGWindow sg_create_window_with_backend(int width, int height, const char* title, SGBackend backend) {
+    // Validate input parameters
+    if (width <= 0 || height <= 0) {
+        sg_log_error("sg_create_window", "Invalid window dimensions");
         exit(EXIT_FAILURE);
     }
 
-    // Set window title safely
-    if (title) {
-        XStoreName(sgw.display, sgw.window, title);
+    // Open X11 display
+    Display* display = XOpenDisplay(NULL);
+    if (!display) {
+        sg_log_error("sg_create_window", "Cannot open X11 display");
+        exit(EXIT_FAILURE);
+    }
+    return create_window_on(display, true, width, height, title, backend);
+}
+
+SGWindow sg_create_shared_window(const SGWindow* share, int width, int height, const char* title) {
+    if (!share || !share->display || width <= 0 || height <= 0) {
+        sg_log_error("sg_create_shared_window", "Invalid window or dimensions");
+        exit(EXIT_FAILURE);
+    }
+    return create_window_on(share->display, false, width, height, title, share->backend);
+}
+
+void sg_destroy_window(SGWindow* sgw) {
+    if (!sgw) return;
+    
+    // Clean up in reverse order of creation; windows from
+    // sg_create_shared_window keep the connection open for each other
+    bool last_window = true;
+    free_widget_index(sgw);
+    free_scene(sgw);
+    if (sgw->resources) {
+        if (sgw->resources->draw) {
+            XftDrawDestroy(sgw->resources->draw);
+        }
+        last_window = release_display_resources(sgw->resources->shared);
+        free(sgw->resources);
+        sgw->resources = NULL;
+    }
+    destroy_back_buffer(sgw);
+    
+    if (sgw->gc) {
+        XFreeGC(sgw->display, sgw->gc);
+        sgw->gc = NULL;
+    }
+    
+    if (sgw->window) {
+        XDestroyWindow(sgw->display, sgw->window);
+        sgw->window = 0;
+    }
+    
+    if (sgw->display) {
+        if (last_window) {
+            XCloseDisplay(sgw->display);
+        } else {
+            XFlush(sgw->display);
+        }
+        sgw->display = NULL;
+    }
+}
+
+//==============================================================================
+// Event Handling
+//==============================================================================
+
+// Whether an event is for the window passed as 'arg', or for no window in
+// particular. Windows that share a connection leave each other's events in
+// the queue.
+static Bool is_window_event(Display* display, XEvent* event, XPointer arg) {
+    (void)display;
+    return event->type == MappingNotify || event->xany.window == *(Window*)arg;
+}
+
+void sg_handle_events(SGWindow* sgw, SGButton buttons[], int button_count) {
+    if (!sgw || !sgw->display) return;
+    
+    // Process all pending events for this window
+    XEvent event;
+    while (XCheckIfEvent(sgw->display, &event, is_window_event, (XPointer)&sgw->window)) {
+
+        switch (event.type) {
+            case ClientMessage: {
+                Atom wm_delete_window = XInternAtom(sgw->display, "WM_DELETE_WINDOW", False);
+                if ((Atom)event.xclient.data.l[0] == wm_delete_window) {
+                    // sg_run hands the window back to its caller
+                    if (sgw->running) {
+                        sgw->running = false;
+                        break;
+                    }
+                    printf("Window closed by user.\n");
+                    exit(0);
+                }
+                break;
+            }
+            
+            case ConfigureNotify: {
+                // A resize drag queues many sizes; only the final one matters
+                while (XCheckTypedWindowEvent(sgw->display, sgw->window, ConfigureNotify, &event)) {
+                }
+                
+                XConfigureEvent xce = event.xconfigure;
+                if (xce.width != sgw->width || xce.height != sgw->height) {
+                    // The background gradient of the old height is no longer needed
+                    if (xce.height != sgw->height) {
+                        invalidate_cached_gradient(sgw->display, sgw->height, 
+                                                   BG_COLOR_TOP, BG_COLOR_BOTTOM);
+                    }
+                    
+                    sgw->width = xce.width;
+                    sgw->height = xce.height;
+                    
+                    // Reallocate only when the back buffer no longer fits the window
+                    if (!back_buffer_fits(sgw)) {
+                        destroy_back_buffer(sgw);
+                        sgw->buffer_width = back_buffer_extent(sgw->width);
+                        sgw->buffer_height = back_buffer_extent(sgw->height);
+                        if (!create_back_buffer(sgw)) {
+                            sg_log_error("sg_handle_events", "Failed to recreate back buffer");
+                        }
+                    }
+                    
+                    // The layout follows the new size
+                    sg_invalidate_window(sgw);
+                }
+                break;
+            }
+            
+            case Expose: {
+                XExposeEvent xee = event.xexpose;
+                damage_rect(sgw, (SGRect){ xee.x, xee.y, xee.width, xee.height });
+                break;
+            }
+            
+            case MotionNotify: {
+                // Only the latest pointer position matters
+                while (XCheckTypedWindowEvent(sgw->display, sgw->window, MotionNotify, &event)) {
+                }
+                
+                // Registered buttons go through the spatial index
+                if (sgw->widgets) {
+                    update_registry_hover(sgw, sg_hit_test(sgw, event.xmotion.x, event.xmotion.y));
+                }
+                
+                // Update hover state with bounds checking
+                if (buttons && button_count > 0) {
+                    for (int i = 0; i < button_count; i++) {
+                        if (buttons[i].registered) continue;
+                        
+                        const bool hovered = is_point_in_rect(event.xmotion.x, event.xmotion.y, 
+                                                             buttons[i].x, buttons[i].y, 
+                                                             buttons[i].width, buttons[i].height);
+                        set_button_hovered(sgw, &buttons[i], hovered);
+                    }
+                }
+                break;
+            }
+            
+            case LeaveNotify: {
+                // Nothing is under a pointer that left the window
+                update_registry_hover(sgw, NULL);
+                if (buttons && button_count > 0) {
+                    for (int i = 0; i < button_count; i++) {
+                        if (!buttons[i].registered) set_button_hovered(sgw, &buttons[i], false);
+                    }
+                }
+                break;
+            }
+            
+            case ButtonPress: {
+                if (event.xbutton.button != Button1) break;
+                
+                SGButton* hit = sgw->widgets ? sgw->widgets->hovered : NULL;
+                if (hit && !hit->pressed) {
+                    hit->pressed = true;
+                    sgw->widgets->pressed = hit;
+                    damage_rect(sgw, button_bounds(hit));
+                }
+                
+                if (buttons && button_count > 0) {
+                    for (int i = 0; i < button_count; i++) {
+                        if (buttons[i].registered) continue;
+                        if (buttons[i].hovered && !buttons[i].pressed) {
+                            buttons[i].pressed = true;
+                            damage_rect(sgw, button_bounds(&buttons[i]));
+                        }
+                    }
+                }
+                break;
+            }
+            
+            case ButtonRelease: {
+                if (event.xbutton.button != Button1) break;
+                
+                // Release the registry's button before its callback runs, which
+                // may well unregister it
+                SGButton* released = sgw->widgets ? sgw->widgets->pressed : NULL;
+                if (released) {
+                    sgw->widgets->pressed = NULL;
+                    released->pressed = false;
+                    damage_rect(sgw, button_bounds(released));
+                    if (released->hovered && released->on_click) {
+                        released->on_click(released, released->user_data);
+                    }
+                }
+                
+                if (buttons && button_count > 0) {
+                    for (int i = 0; i < button_count; i++) {
+                        if (buttons[i].registered) continue;
+                        if (buttons[i].pressed && buttons[i].hovered && buttons[i].on_click) {
+                            buttons[i].on_click(&buttons[i], buttons[i].user_data);
+                        }
+                        if (buttons[i].pressed) {
+                            buttons[i].pressed = false;
+                            damage_rect(sgw, button_bounds(&buttons[i]));
+                        }
+                    }
+                }
+                break;
+            }
+        }
     }
+}
 
-    // Select input events
-    XSelectInput(sgw.display, sgw.window, 
-                ExposureMask | KeyPressMask | ButtonPressMask | 
-                ButtonReleaseMask | PointerMotionMask | StructureNotifyMask);
+// Block until the X connection has events or 'timeout_ms' passes; a
+// negative timeout waits indefinitely. Returns whether events are pending.
+bool sg_wait_events(SGWindow* sgw, int timeout_ms) {
+    if (!sgw || !sgw->display) return false;
+    
+    // XPending also flushes our requests before we go to sleep
+    if (XPending(sgw->display) > 0) return true;
+    
+    // A signal cuts the wait short, so retry with whatever is left of it
+    const unsigned long deadline = get_time_ms() + (unsigned long)(timeout_ms > 0 ? timeout_ms : 0);
+    struct pollfd pfd = { ConnectionNumber(sgw->display), POLLIN, 0 };
+    int wait_ms = timeout_ms;
+    while (poll(&pfd, 1, wait_ms) < 0) {
+        if (errno != EINTR) {
+            sg_log_error("sg_wait_events", "poll failed");
+            return false;
+        }
+        if (timeout_ms >= 0) {
+            const unsigned long now = get_time_ms();
+            wait_ms = now >= deadline ? 0 : (int)(deadline - now);
+        }
+    }
+    return XPending(sgw->display) > 0;
+}
+
+// Milliseconds until the next frame is due, 0 if it is due now, or -1 when
+// nothing is damaged and there is no reason to wake up. Without a back
+// buffer no frame can be drawn, so the damage waits for the next resize
+// to recreate it rather than spinning the loop.
+int sg_frame_timeout(const SGWindow* sgw) {
+    if (!sgw || rect_is_empty(&sgw->damage) || !has_back_buffer(sgw)) return -1;
+    
+    const unsigned long last = sgw->resources ? sgw->resources->last_redraw_time : 0;
+    const unsigned long elapsed = get_time_ms() - last;
+    return (elapsed >= MIN_REDRAW_INTERVAL) ? 0 : (int)(MIN_REDRAW_INTERVAL - elapsed);
+}
+
+void sg_run(SGWindow* sgw, SGButton buttons[], int button_count,
+            void (*draw)(SGWindow*, void*), void* user_data) {
+    if (!sgw || !sgw->display) return;
+    
+    sgw->running = true;
+    while (sgw->running) {
+        sg_handle_events(sgw, buttons, button_count);
+        if (!sgw->running) break;
+        
+        // Scene changes made by callbacks count as damage
+        if (sgw->scene) scene_collect_changes(sgw);
+        
+        // Render as soon as a frame is due; damage that arrives sooner
+        // waits for the interval instead of being dropped
+        const int timeout = sg_frame_timeout(sgw);
+        if (timeout == 0) {
+            sg_clear_window(sgw);
+            if (sgw->scene) scene_emit(sgw);
+            if (draw) draw(sgw, user_data);
+            sg_flush(sgw);
+            continue;
+        }
+        
+        sg_wait_events(sgw, timeout);
+    }
+}
+
+void sg_stop(SGWindow* sgw) {
+    if (!sgw) return;
+    sgw->running = false;
+}
+
+//==============================================================================
+// Drawing Implementation
+//==============================================================================
+
+void sg_invalidate_rect(SGWindow* sgw, int x, int y, int width, int height) {
+    if (!sgw) return;
+    damage_rect(sgw, (SGRect){ x, y, width, height });
+}
+
+void sg_invalidate_window(SGWindow* sgw) {
+    if (!sgw) return;
+    damage_rect(sgw, (SGRect){ 0, 0, sgw->width, sgw->height });
+}
+
+void sg_clear_window(SGWindow* sgw) {
+    if (!sgw || !sgw->display || !has_back_buffer(sgw)) return;
+    
+    // A new frame starts its statistics from scratch
+    struct SGWindowResources* res = sgw->resources;
+    if (res) {
+        res->current = (SGFrameStats){0};
+        res->frame_start = get_frame_time();
+        res->first_request = NextRequest(sgw->display);
+    }
+    
+    // This frame repaints what was damaged so far; drawing may add more
+    // for the next one
+    sgw->frame = sgw->damage;
+    sgw->damage = (SGRect){0};
+    if (rect_is_empty(&sgw->frame)) return;
+    
+    if (sgw->raster) {
+        raster_begin(sgw->display, sgw->raster);
+        raster_fill_gradient_band(sgw, sgw->frame.x, 0, sgw->frame.width, sgw->height, 
+                                  sgw->frame.y, sgw->frame.height, BG_COLOR_TOP, BG_COLOR_BOTTOM);
+    } else {
+        // Keep every draw of this frame inside the repainted area
+        XRectangle clip = frame_clip(sgw);
+        XSetClipRectangles(sgw->display, sgw->gc, 0, 0, &clip, 1, Unsorted);
+        
+        fill_gradient_band(sgw->display, sgw->gc, sgw->back_buffer, 
+                          sgw->frame.x, 0, sgw->frame.width, sgw->height, 
+                          sgw->frame.y, sgw->frame.height,
+                          BG_COLOR_TOP, BG_COLOR_BOTTOM);
+    }
+    
+    if (res) res->current.clear_ms = get_frame_time() - res->frame_start;
+}
+
+// Copy a button's pre-rendered face into the back buffer through its
+// outline mask, leaving the GC clipped to the mask
+static bool copy_button_face(SGWindow* sgw, SGButton* button) {
+    const SGRect bounds = button_bounds(button);
+    const int state = button->pressed ? FACE_PRESSED : 
+                      button->hovered ? FACE_HOVER : FACE_IDLE;
+    // Rendering a face may evict masks, so look up the outline afterwards
+    Pixmap face = get_cached_face(sgw, button, state);
+    Pixmap mask = get_cached_mask(sgw->resources->shared, sgw->back_buffer, button->width, button->height, 
+                                  BUTTON_RADIUS, state == FACE_PRESSED ? MASK_PRESSED : MASK_RAISED);
+    if (!mask || !face) {
+        sg_log_error("sg_draw_button", "Failed to render button");
+        return false;
+    }
+    
+    // The whole button is a single masked copy
+    XSetClipMask(sgw->display, sgw->gc, mask);
+    XSetClipOrigin(sgw->display, sgw->gc, bounds.x, bounds.y);
+    XCopyArea(sgw->display, face, sgw->back_buffer, sgw->gc, 0, 0, 
+              bounds.width, bounds.height, bounds.x, bounds.y);
+    return true;
+}
+
+static void draw_button(SGWindow* sgw, SGButton* button) {
+    if (!sgw || !sgw->display || !has_back_buffer(sgw) || !button || !button->text) return;
+    
+    const SGRect bounds = button_bounds(button);
+    if (button->dirty) {
+        damage_late(sgw, &bounds);
+        button->dirty = false;
+    }
+    if (!rect_intersects(&sgw->frame, &bounds)) return;
+    
+    // Validate button dimensions
+    if (button->width <= 0 || button->height <= 0) return;
+    
+    if (sgw->raster) {
+        raster_draw_button(sgw, button);
+        return;
+    }
+    
+    // Faces are cached per display and drawn with its text color
+    if (!sgw->resources || !sgw->resources->shared->color_allocated) return;
+    if (!copy_button_face(sgw, button)) return;
+    
+    // Back to clipping against the repainted area
+    XRectangle clip = frame_clip(sgw);
+    XSetClipRectangles(sgw->display, sgw->gc, 0, 0, &clip, 1, Unsorted);
+}
+
+// Where a label's text goes
+typedef struct {
+    XftFont* font;
+    const struct SGGlyphRun* run;
+    int x, y;       // Pen position of the baseline
+    SGRect bounds;  // Ink box, padded for antialiasing
+} LabelPlacement;
+
+static bool place_label(SGWindow* sgw, SGLabel* label, LabelPlacement* place) {
+    const int font_size = (label->font_size > 0) ? label->font_size : 24;
+    
+    // Get font with caching
+    XftFont* font = resolve_font(sgw->display, "sans", font_size, &label->font_handle);
+    if (!font) return false;
+    
+    // Text metrics come with the label's cached glyph run
+    const struct SGGlyphRun* run = resolve_glyph_run(sgw->display, font, label->text, 
+                                                     &label->text_cache);
+    const XGlyphInfo extents = run->extents;
+    
+    // Calculate text position based on alignment
+    int text_x = label->x;
+    switch (label->alignment) {
+        case 1: // Center
+            text_x = (sgw->width - extents.width) / 2;
+            break;
+        case 2: // Right
+            text_x = sgw->width - extents.width - label->x;
+            break;
+        default: // Left (0) or invalid
+            break;
+    }
+    
+    const int text_y = label->y + font->ascent;
+    
+    *place = (LabelPlacement){ font, run, text_x, text_y, 
+                               { text_x - extents.x - 1, text_y - extents.y - 1, 
+                                 extents.width + 2, extents.height + 2 } };
+    return true;
+}
+
+// New text repaints both where the old text was and where the new one goes;
+// found while drawing, that waits for the next frame unless already covered
+static void update_label_bounds(SGWindow* sgw, SGLabel* label, const SGRect* bounds, bool drawing) {
+    if (!label->dirty && memcmp(bounds, &label->bounds, sizeof(*bounds)) == 0) return;
+    
+    SGRect changed = label->bounds;
+    rect_union(&changed, bounds);
+    if (drawing) {
+        damage_late(sgw, &changed);
+    } else {
+        damage_rect(sgw, changed);
+    }
+    label->bounds = *bounds;
+    label->dirty = false;
+}
+
+static void draw_label(SGWindow* sgw, SGLabel* label) {
+    if (!sgw || !sgw->display || !has_back_buffer(sgw) || !label || !label->text) return;
+    
+    // An unchanged label outside the repainted area needs no work at all
+    if (!label->dirty && !rect_is_empty(&label->bounds) && 
+        !rect_intersects(&sgw->frame, &label->bounds)) return;
+    
+    // Bind the window's XftDraw; client-side rendering only needs the font
+    XftDraw* draw = sgw->raster ? NULL : bind_window_draw(sgw);
+    if (!sgw->raster && !draw) return;
+    
+    LabelPlacement place;
+    if (!place_label(sgw, label, &place)) return;
+    update_label_bounds(sgw, label, &place.bounds, true);
+    if (!rect_intersects(&sgw->frame, &place.bounds)) return;
+    
+    if (sgw->raster) {
+        raster_draw_glyphs(sgw, place.font, place.x, place.y, place.run, FG_COLOR);
+        return;
+    }
+    
+    XRectangle clip = frame_clip(sgw);
+    XftDrawSetClipRectangles(draw, 0, 0, &clip, 1);
+    
+    // Draw text from the cached glyph indices
+    XftDrawGlyphs(draw, &sgw->resources->shared->text_color, place.font, place.x, place.y, 
+                  place.run->glyphs, place.run->glyph_count);
+}
+
+/**
+ * @brief Vutton drawing
+ */
+void sg_draw_button(SGWindow* sgw, SGButton* button) {
+    const double start = get_frame_time();
+    draw_button(sgw, button);
+    if (sgw && sgw->resources) sgw->resources->current.buttons_ms += get_frame_time() - start;
+}
+
+/**
+ * @brief Enhanced label drawing with improved font management
+ */
+void sg_draw_label(SGWindow* sgw, SGLabel* label) {
+    const double start = get_frame_time();
+    draw_label(sgw, label);
+    if (sgw && sgw->resources) sgw->resources->current.labels_ms += get_frame_time() - start;
+}
+
+void sg_flush(SGWindow* sgw) {
+    if (!sgw || !sgw->display || !has_back_buffer(sgw) || !sgw->window) return;
+    
+    // Nothing was repainted, so the window is already up to date
+    if (rect_is_empty(&sgw->frame)) return;
+    
+    XSetClipMask(sgw->display, sgw->gc, None);
+    
+    // Throttle rendering to prevent excessive CPU usage
+    unsigned long current_time = get_time_ms();
+    struct SGWindowResources* res = sgw->resources;
+    if (res && current_time - res->last_redraw_time < MIN_REDRAW_INTERVAL) {
+        // Skip this frame, but repaint its area with the next one
+        rect_union(&sgw->damage, &sgw->frame);
+        sgw->frame = (SGRect){0};
+        res->stats.skipped++;
+        return;
+    }
+    if (res) res->last_redraw_time = current_time;
+    const double flush_start = get_frame_time();
+    
+    // Copy only the repainted area to the window
+    if (sgw->raster) {
+        raster_present(sgw, &sgw->frame);
+    } else {
+        XCopyArea(sgw->display, sgw->back_buffer, sgw->window, sgw->gc, 
+                  sgw->frame.x, sgw->frame.y, sgw->frame.width, sgw->frame.height, 
+                  sgw->frame.x, sgw->frame.y);
+    }
+    sgw->frame = (SGRect){0};
+    XFlush(sgw->display);
+    
+    if (res) {
+        const double now = get_frame_time();
+        res->current.frames = res->stats.frames + 1;
+        res->current.skipped = res->stats.skipped;
+        res->current.frame_ms = now - res->frame_start;
+        res->current.flush_ms = now - flush_start;
+        res->current.requests = NextRequest(sgw->display) - res->first_request;
+        res->stats = res->current;
+    }
+}
+
+void sg_get_frame_stats(const SGWindow* sgw, SGFrameStats* stats) {
+    if (!stats) return;
+    *stats = (sgw && sgw->resources) ? sgw->resources->stats : (SGFrameStats){0};
+}
+
+//==============================================================================
+// Widget Utilities
+//==============================================================================
+
+SGButton sg_create_button(int id, int x, int y, int width, int height, const char* text) {
+    SGButton button = {0};
+    button.id = id;
+    button.x = x;
+    button.y = y;
+    button.width = width;
+    button.height = height;
+    button.text = sg_safe_strdup(text ? text : "");
+    return button;
+}
+
+SGLabel sg_create_label(int x, int y, const char* text, int font_size, int alignment) {
+    SGLabel label = {0};
+    label.x = x;
+    label.y = y;
+    label.text = sg_safe_strdup(text ? text : "");
+    label.font_size = font_size;
+    label.alignment = alignment;
+    return label;
+}
+
+void sg_destroy_button(SGButton* button) {
+    if (!button) return;
+    free(button->text);
+    button->text = NULL;
+}
+
+void sg_destroy_label(SGLabel* label) {
+    if (!label) return;
+    free(label->text);
+    label->text = NULL;
+}
+
+void sg_button_set_callback(SGButton* button, void (*callback)(struct SGButton*, void*), void* user_data) {
+    if (!button) return;
+    button->on_click = callback;
+    button->user_data = user_data;
+}
+
+void sg_button_set_hover_callback(SGButton* button, void (*callback)(struct SGButton*, bool, void*)) {
+    if (!button) return;
+    button->on_hover = callback;
+}
+
+void sg_button_set_text(SGButton* button, const char* text) {
+    if (!button || !text) return;
+    if (button->text && strcmp(button->text, text) == 0) return;
+    
+    free(button->text);
+    button->text = sg_safe_strdup(text);
+    button->text_cache = (SGTextCache){0};
+    button->dirty = true;
+}
+
+void sg_label_set_text(SGLabel* label, const char* text) {
+    if (!label || !text) return;
+    if (label->text && strcmp(label->text, text) == 0) return;
+    
+    free(label->text);
+    label->text = sg_safe_strdup(text);
+    label->text_cache = (SGTextCache){0};
+    label->dirty = true;
+}
+
+//==============================================================================
+// Retained Scene
+//==============================================================================
+
+/**
+ * @brief A node of a window's retained scene
+ *
+ * A parent always comes before its children in the arena, so a single pass
+ * in node order turns relative positions into window coordinates.
+ */
+struct SGSceneNode {
+    SGNodeKind kind;
+    SGNode parent;
+    int x, y, width, height;  // Relative to the parent
+    unsigned long color;
+    bool visible;
     
-    // Create graphics context
-    sgw.gc = XCreateGC(sgw.display, sgw.window, 0, NULL);
-    if (!sgw.gc) {
-        sg_log_error("sg_create_window", "Failed to create graphics context");
-        XDestroyWindow(sgw.display, sgw.window);
-        XCloseDisplay(sgw.display);
-        exit(EXIT_FAILURE);
-    }
+    // Settled by the layout pass
+    bool shown;               // Visible along with every ancestor
+    int depth;
+    int abs_x, abs_y;
+    SGRect bounds;            // Area a shape paints, empty while hidden
     
-    // Create back buffer for double buffering
-    sgw.back_buffer = XCreatePixmap(sgw.display, sgw.window, width, height, 
-                                   DefaultDepth(sgw.display, screen));
-    if (!sgw.back_buffer) {
-        sg_log_error("sg_create_window", "Failed to create back buffer");
-        XFreeGC(sgw.display, sgw.gc);
-        XDestroyWindow(sgw.display, sgw.window);
-        XCloseDisplay(sgw.display);
-        exit(EXIT_FAILURE);
-    }
+    union {
+        SGButton button;
+        SGLabel label;
+    } widget;
+};
 
-    // Map window and set up close protocol
-    XMapWindow(sgw.display, sgw.window);
+// Shape batched into a frame, sorted into paint order
+typedef struct {
+    int depth;
+    SGNodeKind kind;
+    unsigned long color;
+    SGNode node;
+} SceneItem;
+
+struct SGScene {
+    struct SGSceneNode** chunks; // SCENE_CHUNK nodes each, so nodes never move
+    int chunk_count;
+    int count;
+    bool layout_stale;           // Something moved, resized or changed visibility
     
-    Atom wm_delete_window = XInternAtom(sgw.display, "WM_DELETE_WINDOW", False);
-    XSetWMProtocols(sgw.display, sgw.window, &wm_delete_window, 1);
+    // Batches, kept from frame to frame
+    SceneItem* items;
+    XRectangle* rects;
+    XArc* arcs;
+    int batch_capacity;
+    XftGlyphFontSpec* specs;
+    int spec_capacity;
+};
 
-    return sgw;
+static struct SGSceneNode* scene_node(const struct SGScene* scene, SGNode node) {
+    return &scene->chunks[node / SCENE_CHUNK][node % SCENE_CHUNK];
 }
 
-void sg_destroy_window(SGWindow* sgw) {
-    if (!sgw) return;
-    
-    // Clean up in reverse order of creation
-    if (sgw->back_buffer) {
-        XFreePixmap(sgw->display, sgw->back_buffer);
-        sgw->back_buffer = 0;
+// Node of the window's scene, or NULL for an invalid handle
+static struct SGSceneNode* find_scene_node(SGWindow* sgw, SGNode node) {
+    if (!sgw || !sgw->scene || node < 0 || node >= sgw->scene->count) return NULL;
+    return scene_node(sgw->scene, node);
+}
+
+static SGNode append_scene_node(struct SGScene* scene, SGNodeKind kind, SGNode parent, 
+                                int x, int y, int width, int height) {
+    if (scene->count == scene->chunk_count * SCENE_CHUNK) {
+        scene->chunks = sg_safe_realloc(scene->chunks, (size_t)(scene->chunk_count + 1) * sizeof(*scene->chunks));
+        scene->chunks[scene->chunk_count++] = sg_safe_malloc(SCENE_CHUNK * sizeof(struct SGSceneNode));
     }
     
-    if (sgw->gc) {
-        XFreeGC(sgw->display, sgw->gc);
-        sgw->gc = NULL;
+    const SGNode id = scene->count++;
+    struct SGSceneNode* node = scene_node(scene, id);
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->parent = parent;
+    node->x = x;
+    node->y = y;
+    node->width = width;
+    node->height = height;
+    node->visible = true;
+    scene->layout_stale = true;
+    return id;
+}
+
+// Add a node under a group, creating the scene and its root on first use
+static struct SGSceneNode* add_scene_node(SGWindow* sgw, SGNode parent, SGNodeKind kind, 
+                                          int x, int y, int width, int height, SGNode* id) {
+    *id = SG_NODE_NONE;
+    if (!sgw) return NULL;
+    
+    if (!sgw->scene) {
+        sgw->scene = sg_safe_malloc(sizeof(*sgw->scene));
+        memset(sgw->scene, 0, sizeof(*sgw->scene));
+        append_scene_node(sgw->scene, SG_NODE_GROUP, SG_NODE_NONE, 0, 0, 0, 0);
     }
     
-    if (sgw->window) {
-        XDestroyWindow(sgw->display, sgw->window);
-        sgw->window = 0;
+    const struct SGSceneNode* group = find_scene_node(sgw, parent);
+    if (!group || group->kind != SG_NODE_GROUP) {
+        sg_log_error("add_scene_node", "Parent is not a group");
+        return NULL;
     }
     
-    if (sgw->display) {
-        // Clean up global resources if this was the last window
-        if (g_rm.last_display == sgw->display) {
-            cleanup_font_cache(sgw->display);
-            if (g_rm.draw) {
-                XftDrawDestroy(g_rm.draw);
-                g_rm.draw = NULL;
-            }
-            if (g_rm.xft_initialized) {
-                XftColorFree(sgw->display, 
-                           DefaultVisual(sgw->display, DefaultScreen(sgw->display)),
-                           DefaultColormap(sgw->display, DefaultScreen(sgw->display)),
-                           &g_rm.text_color);
-                g_rm.xft_initialized = false;
-            }
+    *id = append_scene_node(sgw->scene, kind, parent, x, y, width, height);
+    return scene_node(sgw->scene, *id);
+}
+
+static void free_scene(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    if (!scene) return;
+    
+    for (SGNode id = 0; id < scene->count; id++) {
+        struct SGSceneNode* node = scene_node(scene, id);
+        if (node->kind == SG_NODE_BUTTON) {
+            sg_unregister_button(sgw, &node->widget.button);
+            sg_destroy_button(&node->widget.button);
+        } else if (node->kind == SG_NODE_LABEL) {
+            sg_destroy_label(&node->widget.label);
         }
-        
-        XCloseDisplay(sgw->display);
-        sgw->display = NULL;
     }
+    for (int i = 0; i < scene->chunk_count; i++) {
+        free(scene->chunks[i]);
+    }
+    free(scene->chunks);
+    free(scene->items);
+    free(scene->rects);
+    free(scene->arcs);
+    free(scene->specs);
+    free(scene);
+    sgw->scene = NULL;
 }
 
-//==============================================================================
-// Event Handling
-//==============================================================================
-
-void sg_handle_events(SGWindow* sgw, SGButton buttons[], int button_count) {
-    if (!sgw || !sgw->display) return;
+// Settle window coordinates and visibility, repainting every node that
+// moved, resized, appeared or disappeared
+static void scene_layout(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    if (!scene->layout_stale) return;
+    scene->layout_stale = false;
     
-    // Process all pending events
-    while (XPending(sgw->display) > 0) {
-        XEvent event;
-        XNextEvent(sgw->display, &event);
-
-        switch (event.type) {
-            case ClientMessage: {
-                Atom wm_delete_window = XInternAtom(sgw->display, "WM_DELETE_WINDOW", False);
-                if ((Atom)event.xclient.data.l[0] == wm_delete_window) {
-                    printf("Window closed by user.\n");
-                    exit(0);
+    bool moved = false;
+    for (SGNode id = 0; id < scene->count; id++) {
+        struct SGSceneNode* node = scene_node(scene, id);
+        const struct SGSceneNode* parent = (node->parent >= 0) ? scene_node(scene, node->parent) : NULL;
+        node->abs_x = (parent ? parent->abs_x : 0) + node->x;
+        node->abs_y = (parent ? parent->abs_y : 0) + node->y;
+        node->depth = parent ? parent->depth + 1 : 0;
+        node->shown = node->visible && (!parent || parent->shown);
+        
+        switch (node->kind) {
+            case SG_NODE_RECT:
+            case SG_NODE_DOT: {
+                const SGRect bounds = node->shown ? 
+                    (SGRect){ node->abs_x, node->abs_y, node->width, node->height } : (SGRect){0};
+                if (memcmp(&bounds, &node->bounds, sizeof(bounds)) != 0) {
+                    damage_rect(sgw, node->bounds);
+                    damage_rect(sgw, bounds);
+                    node->bounds = bounds;
                 }
                 break;
             }
             
-            case ConfigureNotify: {
-                XConfigureEvent xce = event.xconfigure;
-                if (xce.width != sgw->width || xce.height != sgw->height) {
-                    sgw->width = xce.width;
-                    sgw->height = xce.height;
-                    
-                    // Recreate back buffer with new dimensions
-                    if (sgw->back_buffer) {
-                        XFreePixmap(sgw->display, sgw->back_buffer);
-                    }
-                    sgw->back_buffer = XCreatePixmap(sgw->display, sgw->window, 
-                                                   sgw->width, sgw->height, 
-                                                   DefaultDepth(sgw->display, DefaultScreen(sgw->display)));
-                    if (!sgw->back_buffer) {
-                        sg_log_error("sg_handle_events", "Failed to recreate back buffer");
-                    }
+            case SG_NODE_BUTTON: {
+                SGButton* button = &node->widget.button;
+                const bool changed = button->x != node->abs_x || button->y != node->abs_y ||
+                                     button->width != node->width || button->height != node->height;
+                if (changed && button->registered) {
+                    damage_rect(sgw, button_bounds(button));
                 }
-                break;
-            }
-            
-            case MotionNotify: {
-                // Update hover state with bounds checking
-                if (buttons && button_count > 0) {
-                    for (int i = 0; i < button_count; i++) {
-                        buttons[i].hovered = is_point_in_rect(event.xmotion.x, event.xmotion.y, 
-                                                            buttons[i].x, buttons[i].y, 
-                                                            buttons[i].width, buttons[i].height);
-                    }
+                button->x = node->abs_x;
+                button->y = node->abs_y;
+                button->width = node->width;
+                button->height = node->height;
+                
+                // Registering and unregistering repaint the button themselves
+                if (node->shown && !button->registered) {
+                    sg_register_button(sgw, button);
+                } else if (!node->shown && button->registered) {
+                    sg_unregister_button(sgw, button);
+                } else if (changed && button->registered) {
+                    damage_rect(sgw, button_bounds(button));
+                    moved = true;
                 }
                 break;
             }
             
-            case ButtonPress: {
-                if (event.xbutton.button == Button1 && buttons && button_count > 0) {
-                    for (int i = 0; i < button_count; i++) {
-                        if (buttons[i].hovered) {
-                            buttons[i].pressed = true;
-                        }
-                    }
+            case SG_NODE_LABEL: {
+                SGLabel* label = &node->widget.label;
+                if (!node->shown) {
+                    damage_rect(sgw, label->bounds);
+                    label->bounds = (SGRect){0};
+                } else if (label->x != node->abs_x || label->y != node->abs_y || 
+                           rect_is_empty(&label->bounds)) {
+                    label->x = node->abs_x;
+                    label->y = node->abs_y;
+                    label->dirty = true;
                 }
                 break;
             }
             
-            case ButtonRelease: {
-                if (event.xbutton.button == Button1 && buttons && button_count > 0) {
-                    for (int i = 0; i < button_count; i++) {
-                        if (buttons[i].pressed && buttons[i].hovered && buttons[i].on_click) {
-                            buttons[i].on_click(&buttons[i], buttons[i].user_data);
-                        }
-                        buttons[i].pressed = false;
-                    }
-                }
+            default:
                 break;
+        }
+    }
+    
+    if (moved) sg_widgets_moved(sgw);
+}
+
+// Damage whatever changed through the scene or the widget setters, so the
+// next frame repaints it at once rather than one frame late
+static void scene_collect_changes(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    scene_layout(sgw);
+    
+    for (SGNode id = 0; id < scene->count; id++) {
+        struct SGSceneNode* node = scene_node(scene, id);
+        if (!node->shown) continue;
+        
+        if (node->kind == SG_NODE_BUTTON && node->widget.button.dirty) {
+            damage_rect(sgw, button_bounds(&node->widget.button));
+            node->widget.button.dirty = false;
+        } else if (node->kind == SG_NODE_LABEL && node->widget.label.dirty) {
+            LabelPlacement place;
+            if (place_label(sgw, &node->widget.label, &place)) {
+                update_label_bounds(sgw, &node->widget.label, &place.bounds, false);
             }
         }
     }
 }
 
-//==============================================================================
-// Drawing Implementation
-//==============================================================================
+static int compare_scene_items(const void* a, const void* b) {
+    const SceneItem* x = a;
+    const SceneItem* y = b;
+    if (x->depth != y->depth) return x->depth - y->depth;
+    return x->node - y->node;
+}
 
-void sg_clear_window(SGWindow* sgw) {
-    if (!sgw || !sgw->display || !sgw->back_buffer) return;
-    
-    fill_gradient_rect(sgw->display, sgw->gc, sgw->back_buffer, 
-                      0, 0, sgw->width, sgw->height, 
-                      BG_COLOR_TOP, BG_COLOR_BOTTOM);
+static bool same_scene_batch(const SceneItem* a, const SceneItem* b) {
+    return a->depth == b->depth && a->kind == b->kind && a->color == b->color;
 }
 
-/**
- * @brief Vutton drawing
- */
-void sg_draw_button(SGWindow* sgw, const SGButton* button) {
-    if (!sgw || !sgw->display || !sgw->back_buffer || !button || !button->text) return;
+// Send the shapes inside the frame in paint order, (depth, node id), one
+// fill request per consecutive run of shapes that share a depth, kind and
+// color; batching never reorders overlapping shapes
+static void emit_scene_shapes(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    if (scene->batch_capacity < scene->count) {
+        scene->batch_capacity = scene->count;
+        scene->items = sg_safe_realloc(scene->items, (size_t)scene->batch_capacity * sizeof(SceneItem));
+        scene->rects = sg_safe_realloc(scene->rects, (size_t)scene->batch_capacity * sizeof(XRectangle));
+        scene->arcs = sg_safe_realloc(scene->arcs, (size_t)scene->batch_capacity * sizeof(XArc));
+    }
     
-    const int x = button->x;
-    const int y = button->y;
-    const int w = button->width;
-    const int h = button->height;
-    const int r = BUTTON_RADIUS;
+    int count = 0;
+    for (SGNode id = 0; id < scene->count; id++) {
+        const struct SGSceneNode* node = scene_node(scene, id);
+        if ((node->kind == SG_NODE_RECT || node->kind == SG_NODE_DOT) && 
+            rect_intersects(&sgw->frame, &node->bounds)) {
+            scene->items[count++] = (SceneItem){ node->depth, node->kind, node->color, id };
+        }
+    }
+    if (count == 0) return;
+    qsort(scene->items, (size_t)count, sizeof(SceneItem), compare_scene_items);
     
-    // Validate button dimensions
-    if (w <= 0 || h <= 0) return;
+    if (sgw->raster) {
+        for (int i = 0; i < count; i++) {
+            const struct SGSceneNode* node = scene_node(scene, scene->items[i].node);
+            const int r = (node->kind == SG_NODE_DOT) ? node->width / 2 : 0;
+            raster_rounded_rect(sgw, node->abs_x, node->abs_y, node->width, node->height, r, 
+                                node->color, node->color, false);
+        }
+        return;
+    }
     
-    unsigned long top_color, bottom_color;
-    int draw_y = y;
-
-    // Determine button appearance based on state
-    if (button->pressed) {
-        top_color = BTN_PRESSED_TOP;
-        bottom_color = BTN_PRESSED_BOTTOM;
-        draw_y += SHADOW_OFFSET / 2; // Inset effect
-    } else {
-        if (button->hovered) {
-            top_color = BTN_HOVER_TOP;
-            bottom_color = BTN_HOVER_BOTTOM;
+    bool have_color = false;
+    unsigned long color = 0;
+    for (int i = 0; i < count; ) {
+        const SceneItem* first = &scene->items[i];
+        int n = 0;
+        for (; i < count && same_scene_batch(first, &scene->items[i]); i++) {
+            const SGRect* b = &scene_node(scene, scene->items[i].node)->bounds;
+            if (first->kind == SG_NODE_DOT) {
+                scene->arcs[n++] = (XArc){ (short)b->x, (short)b->y, (unsigned short)b->width, 
+                                           (unsigned short)b->height, 0, 360 * 64 };
+            } else {
+                scene->rects[n++] = (XRectangle){ (short)b->x, (short)b->y, 
+                                                  (unsigned short)b->width, (unsigned short)b->height };
+            }
+        }
+        
+        if (!have_color || color != first->color) {
+            XSetForeground(sgw->display, sgw->gc, first->color);
+            color = first->color;
+            have_color = true;
+        }
+        if (first->kind == SG_NODE_DOT) {
+            XFillArcs(sgw->display, sgw->back_buffer, sgw->gc, scene->arcs, n);
         } else {
-            top_color = BTN_IDLE_TOP;
-            bottom_color = BTN_IDLE_BOTTOM;
+            XFillRectangles(sgw->display, sgw->back_buffer, sgw->gc, scene->rects, n);
         }
-        // Draw drop shadow for non-pressed states
-        fill_rounded_rect(sgw->display, sgw->back_buffer, sgw->gc, 
-                         x + SHADOW_OFFSET, y + SHADOW_OFFSET, w, h, r, SHADOW_COLOR);
     }
+}
 
-    // Create clipping mask for rounded gradient
-    Pixmap mask = XCreatePixmap(sgw->display, sgw->back_buffer, w, h, 1);
-    if (!mask) {
-        sg_log_error("sg_draw_button", "Failed to create clipping mask");
-        return;
+// Copy every button inside the frame, restoring the frame clip once at the end
+static void emit_scene_buttons(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    const bool xlib = !sgw->raster;
+    if (xlib && (!sgw->resources || !sgw->resources->shared->color_allocated)) return;
+    
+    bool clipped = false;
+    for (SGNode id = 0; id < scene->count; id++) {
+        struct SGSceneNode* node = scene_node(scene, id);
+        if (node->kind != SG_NODE_BUTTON || !node->shown) continue;
+        
+        SGButton* button = &node->widget.button;
+        const SGRect bounds = button_bounds(button);
+        if (button->width <= 0 || button->height <= 0 || !rect_intersects(&sgw->frame, &bounds)) continue;
+        
+        if (!xlib) {
+            raster_draw_button(sgw, button);
+        } else if (copy_button_face(sgw, button)) {
+            clipped = true;
+        }
     }
     
-    GC mask_gc = XCreateGC(sgw->display, mask, 0, NULL);
-    if (!mask_gc) {
-        XFreePixmap(sgw->display, mask);
-        sg_log_error("sg_draw_button", "Failed to create mask GC");
-        return;
+    if (clipped) {
+        XRectangle clip = frame_clip(sgw);
+        XSetClipRectangles(sgw->display, sgw->gc, 0, 0, &clip, 1, Unsorted);
+    }
+}
+
+// Draw every label inside the frame; on Xlib all of them go out as a single
+// glyph request
+static void emit_scene_labels(SGWindow* sgw) {
+    struct SGScene* scene = sgw->scene;
+    XftDraw* draw = sgw->raster ? NULL : bind_window_draw(sgw);
+    if (!sgw->raster && !draw) return;
+    
+    int count = 0;
+    for (SGNode id = 0; id < scene->count; id++) {
+        struct SGSceneNode* node = scene_node(scene, id);
+        if (node->kind != SG_NODE_LABEL || !node->shown) continue;
+        
+        SGLabel* label = &node->widget.label;
+        if (!label->dirty && !rect_is_empty(&label->bounds) && 
+            !rect_intersects(&sgw->frame, &label->bounds)) continue;
+        
+        LabelPlacement place;
+        if (!place_label(sgw, label, &place)) continue;
+        update_label_bounds(sgw, label, &place.bounds, true);
+        if (!rect_intersects(&sgw->frame, &place.bounds)) continue;
+        
+        if (sgw->raster) {
+            raster_draw_glyphs(sgw, place.font, place.x, place.y, place.run, FG_COLOR);
+            continue;
+        }
+        
+        const struct SGGlyphRun* run = place.run;
+        if (count + run->glyph_count > scene->spec_capacity) {
+            scene->spec_capacity = (count + run->glyph_count) * 2;
+            scene->specs = sg_safe_realloc(scene->specs, (size_t)scene->spec_capacity * sizeof(XftGlyphFontSpec));
+        }
+        for (int i = 0; i < run->glyph_count; i++) {
+            scene->specs[count++] = (XftGlyphFontSpec){ place.font, run->glyphs[i], 
+                                                        (short)(place.x + run->pen_x[i]), (short)place.y };
+        }
     }
+    if (count == 0) return;
     
-    // Set up clipping mask
-    XSetForeground(sgw->display, mask_gc, 0);
-    XFillRectangle(sgw->display, mask, mask_gc, 0, 0, w, h);
-    fill_rounded_rect(sgw->display, mask, mask_gc, 0, 0, w, h, r, 1);
+    XRectangle clip = frame_clip(sgw);
+    XftDrawSetClipRectangles(draw, 0, 0, &clip, 1);
+    XftDrawGlyphFontSpec(draw, &sgw->resources->shared->text_color, scene->specs, count);
+}
 
-    XSetClipMask(sgw->display, sgw->gc, mask);
-    XSetClipOrigin(sgw->display, sgw->gc, x, draw_y);
+static void scene_emit(SGWindow* sgw) {
+    if (rect_is_empty(&sgw->frame)) return;
+    
+    SGFrameStats* stats = &sgw->resources->current;
+    double start = get_frame_time();
+    emit_scene_shapes(sgw);
+    double now = get_frame_time();
+    stats->shapes_ms += now - start;
+    
+    start = now;
+    emit_scene_buttons(sgw);
+    now = get_frame_time();
+    stats->buttons_ms += now - start;
+    
+    start = now;
+    emit_scene_labels(sgw);
+    stats->labels_ms += get_frame_time() - start;
+}
 
-    // Draw gradient background
-    fill_gradient_rect(sgw->display, sgw->gc, sgw->back_buffer, 
-                      x, draw_y, w, h, top_color, bottom_color);
+SGNode sg_scene_add_group(SGWindow* sgw, SGNode parent, int x, int y) {
+    SGNode id;
+    add_scene_node(sgw, parent, SG_NODE_GROUP, x, y, 0, 0, &id);
+    return id;
+}
 
-    // Clean up clipping
-    XSetClipMask(sgw->display, sgw->gc, None);
-    XFreePixmap(sgw->display, mask);
-    XFreeGC(sgw->display, mask_gc);
+SGNode sg_scene_add_rect(SGWindow* sgw, SGNode parent, int x, int y, int width, int height,
+                         unsigned long color) {
+    SGNode id;
+    struct SGSceneNode* node = add_scene_node(sgw, parent, SG_NODE_RECT, x, y, width, height, &id);
+    if (node) node->color = color;
+    return id;
+}
 
-    // Draw border
-    draw_rounded_rect(sgw->display, sgw->back_buffer, sgw->gc, 
-                     x, draw_y, w - 1, h - 1, r, BORDER_COLOR);
+SGNode sg_scene_add_dot(SGWindow* sgw, SGNode parent, int x, int y, int diameter, 
+                        unsigned long color) {
+    SGNode id;
+    struct SGSceneNode* node = add_scene_node(sgw, parent, SG_NODE_DOT, x, y, diameter, diameter, &id);
+    if (node) node->color = color;
+    return id;
+}
 
-    // Draw text with enhanced font management
-    if (initialize_xft_resources(sgw->display, sgw->back_buffer)) {
-        XftFont* font = get_cached_font(sgw->display, "sans:bold", 12);
-        if (font && g_rm.draw) {
-            XGlyphInfo extents;
-            XftTextExtentsUtf8(sgw->display, font, (const FcChar8*)button->text, 
-                              strlen(button->text), &extents);
+SGNode sg_scene_add_button(SGWindow* sgw, SGNode parent, int id, int width, int height, 
+                           const char* text) {
+    SGNode node_id;
+    struct SGSceneNode* node = add_scene_node(sgw, parent, SG_NODE_BUTTON, 0, 0, width, height, &node_id);
+    if (node) node->widget.button = sg_create_button(id, 0, 0, width, height, text);
+    return node_id;
+}
+
+SGNode sg_scene_add_label(SGWindow* sgw, SGNode parent, const char* text, int font_size, 
+                          int alignment) {
+    SGNode id;
+    struct SGSceneNode* node = add_scene_node(sgw, parent, SG_NODE_LABEL, 0, 0, 0, 0, &id);
+    if (node) node->widget.label = sg_create_label(0, 0, text, font_size, alignment);
+    return id;
+}
 
-            const int text_x = x + (w - extents.width) / 2;
-            const int text_y = draw_y + (h - extents.height) / 2 + font->ascent;
+SGButton* sg_scene_button(SGWindow* sgw, SGNode node) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    return (n && n->kind == SG_NODE_BUTTON) ? &n->widget.button : NULL;
+}
 
-            XftDrawStringUtf8(g_rm.draw, &g_rm.text_color, font, text_x, text_y, 
-                             (const FcChar8*)button->text, strlen(button->text));
-        }
-    }
+SGLabel* sg_scene_label(SGWindow* sgw, SGNode node) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    return (n && n->kind == SG_NODE_LABEL) ? &n->widget.label : NULL;
 }
 
-/**
- * @brief Enhanced label drawing with improved font management
- */
-void sg_draw_label(SGWindow* sgw, const SGLabel* label) {
-    if (!sgw || !sgw->display || !sgw->back_buffer || !label || !label->text) return;
+void sg_scene_move(SGWindow* sgw, SGNode node, int x, int y) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    if (!n || (n->x == x && n->y == y)) return;
     
-    const int font_size = (label->font_size > 0) ? label->font_size : 24;
+    n->x = x;
+    n->y = y;
+    sgw->scene->layout_stale = true;
+}
+
+void sg_scene_resize(SGWindow* sgw, SGNode node, int width, int height) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    if (!n || n->kind == SG_NODE_LABEL) return;
     
-    // Initialize Xft resources
-    if (!initialize_xft_resources(sgw->display, sgw->back_buffer)) return;
+    // A dot stays round
+    n->width = width;
+    n->height = (n->kind == SG_NODE_DOT) ? width : height;
+    sgw->scene->layout_stale = true;
+}
+
+void sg_scene_set_color(SGWindow* sgw, SGNode node, unsigned long color) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    if (!n || (n->kind != SG_NODE_RECT && n->kind != SG_NODE_DOT) || n->color == color) return;
     
-    // Get font with caching
-    XftFont* font = get_cached_font(sgw->display, "sans", font_size);
-    if (!font || !g_rm.draw) return;
+    n->color = color;
+    damage_rect(sgw, n->bounds);
+}
+
+void sg_scene_set_visible(SGWindow* sgw, SGNode node, bool visible) {
+    struct SGSceneNode* n = find_scene_node(sgw, node);
+    if (!n || n->visible == visible) return;
     
-    // Calculate text metrics
-    XGlyphInfo extents;
-    XftTextExtentsUtf8(sgw->display, font, (const FcChar8*)label->text, 
-                      strlen(label->text), &extents);
+    n->visible = visible;
+    sgw->scene->layout_stale = true;
+}
+
+void sg_scene_update(SGWindow* sgw) {
+    if (!sgw || !sgw->display || !sgw->scene) return;
+    scene_collect_changes(sgw);
+}
+
+void sg_scene_render(SGWindow* sgw) {
+    if (!sgw || !sgw->display || !has_back_buffer(sgw)) return;
     
-    // Calculate text position based on alignment
-    int text_x = label->x;
-    switch (label->alignment) {
-        case 1: // Center
-            text_x = (sgw->width - extents.width) / 2;
-            break;
-        case 2: // Right
-            text_x = sgw->width - extents.width - label->x;
-            break;
-        default: // Left (0) or invalid
-            break;
-    }
+    if (sgw->scene) scene_collect_changes(sgw);
+    sg_clear_window(sgw);
+    if (sgw->scene) scene_emit(sgw);
+    sg_flush(sgw);
+}
+
+//==============================================================================
+// Layout Management
+//==============================================================================
+
+SGLayoutState sg_layout_begin(int start_x, int start_y, int padding) {
+    return (SGLayoutState){ start_y, start_x, padding, NULL, SG_SCENE_ROOT };
+}
+
+SGLayoutState sg_layout_begin_window(SGWindow* sgw, int start_x, int start_y, int padding) {
+    return (SGLayoutState){ start_y, start_x, padding, sgw, SG_SCENE_ROOT };
+}
+
+void sg_layout_add_button(SGLayoutState* layout_state, SGButton* button) {
+    if (!layout_state || !button) return;
     
-    const int text_y = label->y + font->ascent;
+    button->x = layout_state->start_x;
+    button->y = layout_state->current_y;
+    layout_state->current_y += button->height + layout_state->padding;
     
-    // Draw text
-    XftDrawStringUtf8(g_rm.draw, &g_rm.text_color, font, text_x, text_y, 
-                     (const FcChar8*)label->text, strlen(label->text));
+    if (layout_state->window) {
+        if (button->registered) {
+            sg_widgets_moved(layout_state->window);
+        } else {
+            sg_register_button(layout_state->window, button);
+        }
+        damage_rect(layout_state->window, button_bounds(button));
+    }
 }
 
-void sg_flush(SGWindow* sgw) {
-    if (!sgw || !sgw->display || !sgw->back_buffer || !sgw->window) return;
+void sg_layout_add_label(SGLayoutState* layout_state, SGLabel* label) {
+    if (!layout_state || !label) return;
     
-    // Throttle rendering to prevent excessive CPU usage
-    unsigned long current_time = get_time_ms();
-    if (current_time - g_rm.last_redraw_time < MIN_REDRAW_INTERVAL) {
-        return; // Skip this frame to maintain reasonable framerate
+    label->x = layout_state->start_x;
+    label->y = layout_state->current_y;
+    label->dirty = true;
+    layout_state->current_y += ((label->font_size > 0) ? label->font_size : 24) + layout_state->padding;
+}
+
+void sg_layout_add_spacing(SGLayoutState* layout_state, int space) {
+    if (!layout_state) return;
+    layout_state->current_y += space;
+}
+
+SGLayoutState sg_layout_begin_group(SGWindow* sgw, SGNode group, int start_x, int start_y, int padding) {
+    return (SGLayoutState){ start_y, start_x, padding, sgw, group };
+}
+
+void sg_layout_add_node(SGLayoutState* layout_state, SGNode node) {
+    struct SGSceneNode* n = layout_state ? find_scene_node(layout_state->window, node) : NULL;
+    if (!n) return;
+    if (n->parent != layout_state->group) {
+        sg_log_error("sg_layout_add_node", "Node is not in the layout's group");
+        return;
     }
-    g_rm.last_redraw_time = current_time;
     
-    // Copy back buffer to window
-    XCopyArea(sgw->display, sgw->back_buffer, sgw->window, sgw->gc, 
-              0, 0, sgw->width, sgw->height, 0, 0);
-    XFlush(sgw->display);
+    sg_scene_move(layout_state->window, node, layout_state->start_x, layout_state->current_y);
+    const int height = (n->kind == SG_NODE_LABEL) ? 
+                       ((n->widget.label.font_size > 0) ? n->widget.label.font_size : 24) : n->height;
+    
+    // Grow the group to enclose it, so an outer layout can stack the group
+    struct SGSceneNode* group = find_scene_node(layout_state->window, layout_state->group);
+    if (n->kind != SG_NODE_LABEL && layout_state->start_x + n->width > group->width) {
+        group->width = layout_state->start_x + n->width;
+    }
+    if (layout_state->current_y + height > group->height) {
+        group->height = layout_state->current_y + height;
+    }
+    layout_state->current_y += height + layout_state->padding;
+}
+
+//==============================================================================
+// Cache Management
+//==============================================================================
+
+// Drop every cached font, glyph run, gradient and button image; open
+// windows keep working and re-create whatever they draw next
+void sg_cleanup_global_resources(void) {
+    for (struct SGDisplayResources* dr = g_rm.displays; dr; dr = dr->next) {
+        cleanup_button_cache(dr);
+        cleanup_gradient_cache(dr->display);
+    }
+    cleanup_font_cache(NULL);
+    purge_glyph_runs(NULL);
+    
+    // Serials keep counting, so widget handles cannot match a regrown cache
+    free(g_rm.font_cache);
+    g_rm.font_cache = NULL;
+    g_rm.font_cache_slots = 0;
+}
+
+void sg_set_font_cache_capacity(int capacity) {
+    g_rm.font_cache_limit = (capacity > 0) ? capacity : 0;
+    
+    const int limit = font_cache_limit();
+    while (g_rm.font_count > limit && g_rm.font_lru_tail) {
+        close_cached_font(g_rm.font_lru_tail - 1);
+        g_rm.font_evictions++;
+    }
+}
+
+void sg_cleanup_unused_fonts(Display* display) {
+    for (int i = 0; i < g_rm.font_cache_slots; i++) {
+        FontCacheEntry* entry = &g_rm.font_cache[i];
+        if (entry->font && (!display || entry->display == display) && 
+            entry->last_used <= g_rm.font_sweep_clock) {
+            close_cached_font(i);
+        }
+    }
+    g_rm.font_sweep_clock = g_rm.font_clock;
+}
+
+void sg_get_font_cache_stats(int* total_fonts, int* cache_hits, int* cache_misses) {
+    if (total_fonts) *total_fonts = g_rm.font_count;
+    if (cache_hits) *cache_hits = (g_rm.font_hits > INT_MAX) ? INT_MAX : (int)g_rm.font_hits;
+    if (cache_misses) *cache_misses = (g_rm.font_misses > INT_MAX) ? INT_MAX : (int)g_rm.font_misses;
+}
+
+void sg_get_font_cache_counters(SGFontCacheStats* stats) {
+    if (!stats) return;
+    stats->total_fonts = g_rm.font_count;
+    stats->capacity = font_cache_limit();
+    stats->hits = g_rm.font_hits;
+    stats->misses = g_rm.font_misses;
+    stats->evictions = g_rm.font_evictions;
+}
+
+//==============================================================================
+// State Queries
+//==============================================================================
+
+void sg_get_window_size(SGWindow* sgw, int* width, int* height) {
+    if (!sgw) return;
+    if (width) *width = sgw->width;
+    if (height) *height = sgw->height;
+}
+
+bool sg_button_is_hovered(const SGButton* button) {
+    return button && button->hovered;
+}
+
+bool sg_button_is_pressed(const SGButton* button) {
+    return button && button->pressed;
 }
\ No newline at end of file
@@ -6,11 +6,34 @@
 #include <time.h>
 
 struct SGButton;
+struct SGRaster;
+struct SGWidgetIndex;
+struct SGGlyphRun;
+struct SGWindowResources;
+struct SGScene;
 
 //==============================================================================
 // Data Structures 
 //==============================================================================
 
+/**
+ * @brief An axis-aligned rectangle in window coordinates.
+ *
+ * A rectangle with a non-positive width or height is empty.
+ */
+typedef struct {
+    int x, y, width, height;
+} SGRect;
+
+/**
+ * @brief How a window renders its frames.
+ */
+typedef enum {
+    SG_BACKEND_AUTO,  // Client-side rendering when the server supports it, Xlib otherwise
+    SG_BACKEND_XLIB,  // Core X11 requests into a server-side back buffer
+    SG_BACKEND_IMAGE  // Antialiased client-side ARGB buffer, uploaded once per frame
+} SGBackend;
+
 /**
  * @brief Represents the core components of a window managed by X11.
  *
@@ -23,9 +46,73 @@ typedef struct {
     GC gc;
     int width;
     int height;
-    Pixmap back_buffer;
+    Pixmap back_buffer;         // Xlib back buffer
+    int buffer_width;           // Allocated back buffer size, never below
+    int buffer_height;          // the window's, so a resize can reuse it
+    SGBackend backend;          // Backend in use, never SG_BACKEND_AUTO
+    struct SGRaster* raster;    // Client-side back buffer, or NULL
+    struct SGWidgetIndex* widgets; // Registered buttons, or NULL
+    struct SGWindowResources* resources; // Xft draw and per-display caches
+    struct SGScene* scene;      // Retained widgets, or NULL
+    SGRect damage; // Area to repaint on the next frame
+    SGRect frame;  // Area being repainted by the current frame
+    bool running;  // Inside sg_run
 } SGWindow;
 
+/**
+ * @brief A widget's handle on the shaped and measured form of its text.
+ *
+ * Runs live in a shared cache; the handle is only trusted while the run's
+ * serial and the widget's text pointer still match. sg_button_set_text and
+ * sg_label_set_text reset it.
+ */
+typedef struct {
+    struct SGGlyphRun* run;
+    unsigned long serial;
+    const char* text;
+} SGTextCache;
+
+/**
+ * @brief A widget's handle on its resolved font.
+ *
+ * Lets drawing skip the font cache lookup while the cached font is still
+ * the one the handle was resolved to.
+ */
+typedef struct {
+    int slot;             // Font cache slot + 1, 0 when unresolved
+    unsigned long serial; // Serial the slot had when resolved
+    int size;             // Size the font was resolved for
+} SGFontHandle;
+
+/**
+ * @brief Font cache counters, accumulated since startup.
+ */
+typedef struct {
+    int total_fonts;        // Fonts currently open
+    int capacity;           // Fonts kept open before evicting
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} SGFontCacheStats;
+
+/**
+ * @brief What the last frame a window presented cost.
+ *
+ * Times are wall-clock milliseconds. 'requests' counts the X requests
+ * queued from sg_clear_window to the end of sg_flush.
+ */
+typedef struct {
+    unsigned long frames;   // Frames presented since the window was created
+    unsigned long skipped;  // Frames held back by the redraw throttle
+    double frame_ms;        // From sg_clear_window to the end of sg_flush
+    double clear_ms;
+    double shapes_ms;       // Retained scene rects and dots
+    double buttons_ms;
+    double labels_ms;
+    double flush_ms;        // Copy to the window and XFlush
+    unsigned long requests;
+} SGFrameStats;
+
 /**
  * @brief Represents the state of a button widget.
  */
@@ -36,7 +123,12 @@ typedef struct SGButton {
     bool pressed;
     bool hovered;
     void (*on_click)(struct SGButton* self, void* user_data);
+    void (*on_hover)(struct SGButton* self, bool entered, void* user_data);
     void* user_data;
+    bool dirty;      // Appearance changed since it was last drawn
+    bool registered; // Hit-tested through its window's widget registry
+    SGTextCache text_cache;
+    SGFontHandle font_handle;
 } SGButton;
 
 /**
@@ -47,15 +139,47 @@ typedef struct {
     char* text;
     int font_size; // 0 for default
     int alignment; // 0: left, 1: center, 2: right
+    SGRect bounds; // Area covered when last drawn
+    bool dirty;    // Text changed since it was last drawn
+    SGTextCache text_cache;
+    SGFontHandle font_handle;
 } SGLabel;
 
+/**
+ * @brief Handle of a node in a window's retained scene.
+ *
+ * Nodes live as long as their window. SG_SCENE_ROOT is the group every
+ * other node descends from.
+ */
+typedef int SGNode;
+
+#define SG_SCENE_ROOT 0
+#define SG_NODE_NONE  (-1)
+
+/**
+ * @brief Kinds of node in a retained scene.
+ */
+typedef enum {
+    SG_NODE_GROUP,  // Offsets its children, draws nothing
+    SG_NODE_RECT,   // Solid rectangle
+    SG_NODE_DOT,    // Solid disc with the node's width as diameter
+    SG_NODE_BUTTON,
+    SG_NODE_LABEL
+} SGNodeKind;
+
 /**
  * @brief A struct to manage the state of a simple vertical layout.
+ *
+ * When 'window' is set, every button added to the layout is registered
+ * with that window for hit-testing. Layouts from sg_layout_begin_group
+ * place scene nodes inside 'group' and grow the group to enclose them.
  */
 typedef struct {
     int current_y;
     int start_x;
     int padding;
+    SGWindow* window;
+    SGNode group;
 } SGLayoutState;
 
 //==============================================================================
@@ -64,22 +188,81 @@ typedef struct {
 
 // --- Window Management ---
 SGWindow sg_create_window(int width, int height, const char* title);
+SGWindow sg_create_window_with_backend(int width, int height, const char* title, SGBackend backend);
+// Opens another window on 'share's X connection, with its backend. Windows
+// on one connection share button images, gradients and fonts, and the
+// connection closes with the last of them. Each only takes its own events,
+// so handle all of them from the same loop.
+SGWindow sg_create_shared_window(const SGWindow* share, int width, int height, const char* title);
 void sg_destroy_window(SGWindow* sg_window);
 
 // --- Event Handling ---
 void sg_handle_events(SGWindow* sg_window, SGButton buttons[], int button_count);
+bool sg_wait_events(SGWindow* sg_window, int timeout_ms);
+int sg_frame_timeout(const SGWindow* sg_window);
+
+// Runs the event loop: blocks while nothing is damaged and otherwise calls
+// 'draw' between sg_clear_window and sg_flush at most once per frame interval.
+// Returns after sg_stop or when the window is closed.
+void sg_run(SGWindow* sg_window, SGButton buttons[], int button_count,
+            void (*draw)(SGWindow* sg_window, void* user_data), void* user_data);
+void sg_stop(SGWindow* sg_window);
 
 // --- Drawing ---
+// A frame only repaints the damaged area: sg_clear_window picks it up,
+// the draw calls skip widgets outside it, and sg_flush copies it out.
 void sg_clear_window(SGWindow* sg_window);
-void sg_draw_button(SGWindow* sg_window, const SGButton* button);
-void sg_draw_label(SGWindow* sg_window, const SGLabel* label);
+void sg_draw_button(SGWindow* sg_window, SGButton* button);
+void sg_draw_label(SGWindow* sg_window, SGLabel* label);
 void sg_flush(SGWindow* sg_window);
+void sg_invalidate_rect(SGWindow* sg_window, int x, int y, int width, int height);
+void sg_invalidate_window(SGWindow* sg_window);
+
+// --- Widget Registry ---
+// Registered buttons are hit-tested through a spatial index, so
+// sg_handle_events can be called with no button array at all. Call
+// sg_widgets_moved after moving registered buttons, and unregister a
+// button before destroying it.
+void sg_register_button(SGWindow* sg_window, SGButton* button);
+void sg_unregister_button(SGWindow* sg_window, SGButton* button);
+void sg_widgets_moved(SGWindow* sg_window);
+SGButton* sg_hit_test(SGWindow* sg_window, int x, int y);
 
 // --- Layout Management ---
 SGLayoutState sg_layout_begin(int start_x, int start_y, int padding);
+SGLayoutState sg_layout_begin_window(SGWindow* sg_window, int start_x, int start_y, int padding);
 void sg_layout_add_button(SGLayoutState* layout_state, SGButton* button);
 void sg_layout_add_label(SGLayoutState* layout_state, SGLabel* label);
 void sg_layout_add_spacing(SGLayoutState* layout_state, int space);
+SGLayoutState sg_layout_begin_group(SGWindow* sg_window, SGNode group, int start_x, int start_y, int padding);
+void sg_layout_add_node(SGLayoutState* layout_state, SGNode node);
+
+// --- Retained Scene ---
+// Nodes are kept by the window and positioned relative to their parent.
+// sg_scene_render repaints only what changed since the previous frame, and
+// sends each kind of shape in batches: deeper nodes paint over shallower
+// ones and, at the same depth, later-added nodes over earlier ones; then
+// buttons, then labels. sg_run renders the scene before 'draw'.
+SGNode sg_scene_add_group(SGWindow* sg_window, SGNode parent, int x, int y);
+SGNode sg_scene_add_rect(SGWindow* sg_window, SGNode parent, int x, int y, int width, int height,
+                         unsigned long color);
+SGNode sg_scene_add_dot(SGWindow* sg_window, SGNode parent, int x, int y, int diameter, 
+                        unsigned long color);
+SGNode sg_scene_add_button(SGWindow* sg_window, SGNode parent, int id, int width, int height, 
+                           const char* text);
+SGNode sg_scene_add_label(SGWindow* sg_window, SGNode parent, const char* text, int font_size, 
+                          int alignment);
+// Scene widgets take the usual setters, such as sg_button_set_text
+SGButton* sg_scene_button(SGWindow* sg_window, SGNode node);
+SGLabel* sg_scene_label(SGWindow* sg_window, SGNode node);
+void sg_scene_move(SGWindow* sg_window, SGNode node, int x, int y);
+void sg_scene_resize(SGWindow* sg_window, SGNode node, int width, int height);
+void sg_scene_set_color(SGWindow* sg_window, SGNode node, unsigned long color);
+void sg_scene_set_visible(SGWindow* sg_window, SGNode node, bool visible);
+// Turns scene changes into damage, for loops that wait on sg_frame_timeout;
+// sg_scene_render and sg_run do this themselves
+void sg_scene_update(SGWindow* sg_window);
+void sg_scene_render(SGWindow* sg_window);
 
 //==============================================================================
 //Utility Functions
@@ -95,6 +278,7 @@ void sg_destroy_label(SGLabel* label);
 
 // --- Widget Property Management ---
 void sg_button_set_callback(SGButton* button, void (*callback)(struct SGButton*, void*), void* user_data);
+void sg_button_set_hover_callback(SGButton* button, void (*callback)(struct SGButton*, bool, void*));
 void sg_button_set_text(SGButton* button, const char* text);
 void sg_label_set_text(SGLabel* label, const char* text);
 
@@ -106,11 +290,16 @@ bool sg_button_is_hovered(const SGButton* button);
 bool sg_button_is_pressed(const SGButton* button);
 
 // --- Resource Management ---
+// Drops every cached font and image; open windows re-create what they draw
 void sg_cleanup_global_resources(void);
+// Closes the display's fonts that were not used since the previous call
 void sg_cleanup_unused_fonts(Display* display);
+void sg_set_font_cache_capacity(int capacity);
 
 // --- Performance Monitoring ---
 void sg_get_font_cache_stats(int* total_fonts, int* cache_hits, int* cache_misses);
+void sg_get_font_cache_counters(SGFontCacheStats* stats);
+void sg_get_frame_stats(const SGWindow* sg_window, SGFrameStats* stats);
 
 //==============================================================================
 // Backward Compatibility Macros